@@ -0,0 +1,269 @@
+#include "AllocationTracker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if __has_include(<dlfcn.h>)
+#include <dlfcn.h>
+#endif
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define GAME_RETURN_ADDRESS() _ReturnAddress()
+#else
+#define GAME_RETURN_ADDRESS() __builtin_return_address(0)
+#endif
+
+namespace {
+
+struct AtomicCounters
+{
+  std::atomic<std::uint64_t> allocations{ 0 };
+  std::atomic<std::uint64_t> deallocations{ 0 };
+  std::atomic<std::uint64_t> bytes{ 0 };
+
+  [[nodiscard]] Game::Allocations::Counters load() const noexcept
+  {
+    return { allocations.load(std::memory_order_relaxed),
+             deallocations.load(std::memory_order_relaxed),
+             bytes.load(std::memory_order_relaxed) };
+  }
+};
+
+struct AtomicSite
+{
+  std::atomic<const void *>  address{ nullptr };
+  std::atomic<std::uint64_t> allocations{ 0 };
+  std::atomic<std::uint64_t> bytes{ 0 };
+};
+
+// operator new must not allocate, so sites live in a fixed open addressing
+// table; once it is full new sites are only counted in the totals
+constexpr std::size_t SiteCount = 4096;
+
+AtomicCounters                    totals;
+AtomicCounters                    frame;
+std::array<AtomicSite, SiteCount> sites;
+
+void recordSite(const void *address, const std::size_t size) noexcept
+{
+  auto index = (reinterpret_cast<std::uintptr_t>(address) >> 2U) % SiteCount;
+  for (std::size_t probe = 0; probe < SiteCount; ++probe, index = (index + 1) % SiteCount) {
+    auto &      site     = sites[index];
+    const void *expected = nullptr;
+    if (site.address.load(std::memory_order_relaxed) == address
+        || site.address.compare_exchange_strong(expected, address, std::memory_order_relaxed)
+        || expected == address) {
+      site.allocations.fetch_add(1, std::memory_order_relaxed);
+      site.bytes.fetch_add(size, std::memory_order_relaxed);
+      return;
+    }
+  }
+}
+
+void recordAllocation(const void *site, const std::size_t size) noexcept
+{
+  totals.allocations.fetch_add(1, std::memory_order_relaxed);
+  totals.bytes.fetch_add(size, std::memory_order_relaxed);
+  frame.allocations.fetch_add(1, std::memory_order_relaxed);
+  frame.bytes.fetch_add(size, std::memory_order_relaxed);
+  recordSite(site, size);
+}
+
+void recordDeallocation(const void *ptr) noexcept
+{
+  if (ptr == nullptr) { return; }
+  totals.deallocations.fetch_add(1, std::memory_order_relaxed);
+  frame.deallocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void *allocate(const std::size_t size, const void *site) noexcept
+{
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr != nullptr) { recordAllocation(site, size); }
+  return ptr;
+}
+
+void *allocateAligned(const std::size_t size, const std::align_val_t alignment, const void *site) noexcept
+{
+  const auto align = static_cast<std::size_t>(alignment);
+#if defined(_MSC_VER)
+  void *ptr = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+  void *ptr = std::aligned_alloc(align, (std::max(size, std::size_t{ 1 }) + align - 1) / align * align);
+#endif
+  if (ptr != nullptr) { recordAllocation(site, size); }
+  return ptr;
+}
+
+void release(void *ptr) noexcept
+{
+  recordDeallocation(ptr);
+  std::free(ptr);
+}
+
+void releaseAligned(void *ptr) noexcept
+{
+  recordDeallocation(ptr);
+#if defined(_MSC_VER)
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+}// namespace
+
+namespace Game::Allocations {
+
+Counters total() noexcept { return totals.load(); }
+
+Counters currentFrame() noexcept { return frame.load(); }
+
+Counters endFrame() noexcept
+{
+  return { frame.allocations.exchange(0, std::memory_order_relaxed),
+           frame.deallocations.exchange(0, std::memory_order_relaxed),
+           frame.bytes.exchange(0, std::memory_order_relaxed) };
+}
+
+std::size_t topSites(std::span<Site> out) noexcept
+{
+  std::size_t found = 0;
+  for (const auto &site : sites) {
+    const auto *address = site.address.load(std::memory_order_relaxed);
+    if (address == nullptr) { continue; }
+
+    const Site current{ address,
+                        site.allocations.load(std::memory_order_relaxed),
+                        site.bytes.load(std::memory_order_relaxed) };
+
+    // insertion into the already sorted prefix of out
+    auto position = found < out.size() ? found : out.size();
+    while (position > 0 && out[position - 1].allocations < current.allocations) {
+      if (position < out.size()) { out[position] = out[position - 1]; }
+      --position;
+    }
+    if (position < out.size()) {
+      out[position] = current;
+      found         = std::min(found + 1, out.size());
+    }
+  }
+  return found;
+}
+
+std::string describe(const void *address)
+{
+  std::array<char, 32> fallback{};
+  std::snprintf(fallback.data(), fallback.size(), "%p", address);
+
+#if __has_include(<dlfcn.h>)
+  Dl_info info{};
+  if (dladdr(address, &info) != 0 && info.dli_sname != nullptr) {
+#if __has_include(<cxxabi.h>)
+    int   status    = 0;
+    char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    if (status == 0 && demangled != nullptr) {
+      std::string name{ demangled };
+      std::free(demangled);
+      return name;
+    }
+#endif
+    return info.dli_sname;
+  }
+#endif
+
+  return fallback.data();
+}
+
+void *countedMalloc(const std::size_t size, void * /*userData*/) noexcept
+{
+  return allocate(size, GAME_RETURN_ADDRESS());
+}
+
+void countedFree(void *ptr, void * /*userData*/) noexcept { release(ptr); }
+
+}// namespace Game::Allocations
+
+// NOLINTNEXTLINE: replacing the global allocation functions is the point
+void *operator new(const std::size_t size)
+{
+  if (auto *ptr = allocate(size, GAME_RETURN_ADDRESS()); ptr != nullptr) { return ptr; }
+  throw std::bad_alloc{};
+}
+
+void *operator new[](const std::size_t size)
+{
+  if (auto *ptr = allocate(size, GAME_RETURN_ADDRESS()); ptr != nullptr) { return ptr; }
+  throw std::bad_alloc{};
+}
+
+void *operator new(const std::size_t size, const std::nothrow_t & /*unused*/) noexcept
+{
+  return allocate(size, GAME_RETURN_ADDRESS());
+}
+
+void *operator new[](const std::size_t size, const std::nothrow_t & /*unused*/) noexcept
+{
+  return allocate(size, GAME_RETURN_ADDRESS());
+}
+
+void *operator new(const std::size_t size, const std::align_val_t alignment)
+{
+  if (auto *ptr = allocateAligned(size, alignment, GAME_RETURN_ADDRESS()); ptr != nullptr) { return ptr; }
+  throw std::bad_alloc{};
+}
+
+void *operator new[](const std::size_t size, const std::align_val_t alignment)
+{
+  if (auto *ptr = allocateAligned(size, alignment, GAME_RETURN_ADDRESS()); ptr != nullptr) { return ptr; }
+  throw std::bad_alloc{};
+}
+
+void *operator new(const std::size_t size,
+  const std::align_val_t alignment,
+  const std::nothrow_t & /*unused*/) noexcept
+{
+  return allocateAligned(size, alignment, GAME_RETURN_ADDRESS());
+}
+
+void *operator new[](const std::size_t size,
+  const std::align_val_t alignment,
+  const std::nothrow_t & /*unused*/) noexcept
+{
+  return allocateAligned(size, alignment, GAME_RETURN_ADDRESS());
+}
+
+void operator delete(void *ptr) noexcept { release(ptr); }
+void operator delete[](void *ptr) noexcept { release(ptr); }
+void operator delete(void *ptr, const std::size_t /*size*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, const std::size_t /*size*/) noexcept { release(ptr); }
+void operator delete(void *ptr, const std::nothrow_t & /*unused*/) noexcept { release(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t & /*unused*/) noexcept { release(ptr); }
+
+void operator delete(void *ptr, const std::align_val_t /*alignment*/) noexcept { releaseAligned(ptr); }
+void operator delete[](void *ptr, const std::align_val_t /*alignment*/) noexcept { releaseAligned(ptr); }
+void operator delete(void *ptr, const std::size_t /*size*/, const std::align_val_t /*alignment*/) noexcept
+{
+  releaseAligned(ptr);
+}
+void operator delete[](void *ptr, const std::size_t /*size*/, const std::align_val_t /*alignment*/) noexcept
+{
+  releaseAligned(ptr);
+}
+void operator delete(void *ptr, const std::align_val_t /*alignment*/, const std::nothrow_t & /*unused*/) noexcept
+{
+  releaseAligned(ptr);
+}
+void operator delete[](void *ptr, const std::align_val_t /*alignment*/, const std::nothrow_t & /*unused*/) noexcept
+{
+  releaseAligned(ptr);
+}
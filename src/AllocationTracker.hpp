@@ -0,0 +1,59 @@
+#ifndef MYPROJECT_ALLOCATIONTRACKER_HPP
+#define MYPROJECT_ALLOCATIONTRACKER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Counts heap allocations by replacing the global operator new / delete.
+// Only available when AllocationTracker.cpp is part of the build, which the
+// ENABLE_ALLOCATION_TRACKING option does along with defining GAME_TRACK_ALLOCATIONS.
+namespace Game::Allocations {
+
+struct Counters
+{
+  std::uint64_t allocations{ 0 };
+  std::uint64_t deallocations{ 0 };
+  std::uint64_t bytes{ 0 };
+};
+
+// A call site is the return address of operator new, the function that called
+// it directly. Allocations made inside compiled library code, std::string
+// growth in libstdc++ for example, are therefore attributed to that library
+// function rather than to the game code that used it. Walking further up the
+// stack is not safe in operator new: __builtin_return_address(1) needs frame
+// pointers and unwinding may allocate.
+struct Site
+{
+  const void *  address{ nullptr };
+  std::uint64_t allocations{ 0 };
+  std::uint64_t bytes{ 0 };
+};
+
+// everything since program start
+[[nodiscard]] Counters total() noexcept;
+
+// since the last call to endFrame
+[[nodiscard]] Counters currentFrame() noexcept;
+
+// closes the current frame and returns its counters
+Counters endFrame() noexcept;
+
+// fills out with the sites with the most allocations, returns how many were written
+std::size_t topSites(std::span<Site> out) noexcept;
+
+// Symbol name for a call site when the platform can tell, the address
+// otherwise. dladdr only finds exported symbols, so executables need to be
+// linked with -rdynamic (ENABLE_EXPORTS) for their own functions to be named.
+[[nodiscard]] std::string describe(const void *address);
+
+// Counted malloc / free for libraries with their own allocator hooks. ImGui
+// allocates through malloc, pass these to ImGui::SetAllocatorFunctions before
+// its context is created so its allocations show up as well.
+void *countedMalloc(std::size_t size, void *userData) noexcept;
+void  countedFree(void *ptr, void *userData) noexcept;
+
+}// namespace Game::Allocations
+
+#endif// MYPROJECT_ALLOCATIONTRACKER_HPP
@@ -0,0 +1,420 @@
+#ifndef MYPROJECT_ASSETS_HPP
+#define MYPROJECT_ASSETS_HPP
+
+#include <SFML/Graphics/Font.hpp>
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "Input.hpp"
+#include "ThreadPool.hpp"
+
+namespace Game {
+
+enum class AssetState { Loading, Uploading, Ready, Failed };
+
+// Decoded RGBA images, so startup can skip PNG decoding when nothing changed.
+// Each source has one entry, named after a hash of its path. The header
+// repeats the source path, size and modification time, and an entry is only
+// used when all three still match, so neither a stale entry nor a hash
+// collision can hand out another image's pixels.
+class AssetDiskCache
+{
+public:
+  explicit AssetDiskCache(std::filesystem::path cacheDirectory) : directory{ std::move(cacheDirectory) }
+  {
+    std::filesystem::create_directories(directory);
+  }
+
+  [[nodiscard]] std::optional<sf::Image> loadImage(const std::filesystem::path &source) const
+  {
+    const auto expected = Source::of(source);
+    std::ifstream ifs(entry(expected), std::ios::binary);
+    if (!ifs) { return {}; }
+
+    std::uint32_t magic{};
+    ifs.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    if (!ifs || magic != ImageMagic) { return {}; }
+
+    const auto stored = Source::read(ifs);
+    if (!stored || *stored != expected) { return {}; }
+
+    std::uint32_t width{};
+    std::uint32_t height{};
+    ifs.read(reinterpret_cast<char *>(&width), sizeof(width));
+    ifs.read(reinterpret_cast<char *>(&height), sizeof(height));
+    if (!ifs) { return {}; }
+
+    std::vector<sf::Uint8> pixels(std::size_t{ width } * height * 4);
+    ifs.read(reinterpret_cast<char *>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+    if (!ifs) { return {}; }
+
+    sf::Image image;
+    image.create(width, height, pixels.data());
+    return image;
+  }
+
+  void storeImage(const std::filesystem::path &source, const sf::Image &image) const
+  {
+    const auto key       = Source::of(source);
+    const auto target    = entry(key);
+    auto       temporary = target;
+    temporary += ".tmp";
+
+    {
+      std::ofstream ofs(temporary, std::ios::binary);
+      const auto    size   = image.getSize();
+      const auto    magic  = ImageMagic;
+      const auto    width  = static_cast<std::uint32_t>(size.x);
+      const auto    height = static_cast<std::uint32_t>(size.y);
+      ofs.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+      key.write(ofs);
+      ofs.write(reinterpret_cast<const char *>(&width), sizeof(width));
+      ofs.write(reinterpret_cast<const char *>(&height), sizeof(height));
+      ofs.write(reinterpret_cast<const char *>(image.getPixelsPtr()),
+        static_cast<std::streamsize>(std::size_t{ width } * height * 4));
+      if (!ofs) { return; }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporary, target, ec);
+  }
+
+private:
+  static constexpr std::uint32_t ImageMagic = 0x324D4947;// "GIM2"
+
+  // what an entry was decoded from
+  struct Source
+  {
+    std::string                          path;
+    std::uintmax_t                       size{ 0 };
+    std::filesystem::file_time_type::rep modified{ 0 };
+
+    [[nodiscard]] bool operator==(const Source &) const = default;
+
+    static Source of(const std::filesystem::path &source)
+    {
+      return { std::filesystem::absolute(source).string(),
+        std::filesystem::file_size(source),
+        std::filesystem::last_write_time(source).time_since_epoch().count() };
+    }
+
+    void write(std::ostream &os) const
+    {
+      const auto length = static_cast<std::uint32_t>(path.size());
+      os.write(reinterpret_cast<const char *>(&length), sizeof(length));
+      os.write(path.data(), static_cast<std::streamsize>(path.size()));
+      os.write(reinterpret_cast<const char *>(&size), sizeof(size));
+      os.write(reinterpret_cast<const char *>(&modified), sizeof(modified));
+    }
+
+    static std::optional<Source> read(std::istream &is)
+    {
+      constexpr std::uint32_t MaxPath = 4096;
+
+      Source        source;
+      std::uint32_t length{};
+      is.read(reinterpret_cast<char *>(&length), sizeof(length));
+      if (!is || length > MaxPath) { return {}; }
+      source.path.resize(length);
+      is.read(source.path.data(), static_cast<std::streamsize>(length));
+      is.read(reinterpret_cast<char *>(&source.size), sizeof(source.size));
+      is.read(reinterpret_cast<char *>(&source.modified), sizeof(source.modified));
+      if (!is) { return {}; }
+      return source;
+    }
+  };
+
+  [[nodiscard]] std::filesystem::path entry(const Source &source) const
+  {
+    return directory / (std::to_string(std::hash<std::string>{}(source.path)) + ".rgba");
+  }
+
+  std::filesystem::path directory;
+};
+
+// fonts keep the file contents alive, sf::Font reads from them lazily
+struct FontAsset
+{
+  std::vector<char> data;
+  sf::Font          font;
+};
+
+// How each asset type is decoded on a worker and finished on the main thread.
+template<typename T> struct AssetLoader;
+
+template<> struct AssetLoader<sf::Texture>
+{
+  using Decoded = sf::Image;
+
+  static Decoded decode(const std::filesystem::path &path, const AssetDiskCache *cache)
+  {
+    if (cache != nullptr) {
+      if (auto image = cache->loadImage(path); image) { return std::move(*image); }
+    }
+
+    sf::Image image;
+    if (!image.loadFromFile(path.string())) { throw std::runtime_error("unable to decode image: " + path.string()); }
+    if (cache != nullptr) { cache->storeImage(path, image); }
+    return image;
+  }
+
+  // needs the GL context of the main thread
+  static void upload(Decoded &&image, sf::Texture &texture)
+  {
+    if (!texture.loadFromImage(image)) { throw std::runtime_error("unable to create texture"); }
+  }
+};
+
+template<> struct AssetLoader<FontAsset>
+{
+  using Decoded = std::vector<char>;
+
+  static Decoded decode(const std::filesystem::path &path, const AssetDiskCache * /*cache*/)
+  {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) { throw std::runtime_error("unable to open font: " + path.string()); }
+    return { std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+  }
+
+  static void upload(Decoded &&data, FontAsset &font)
+  {
+    font.data = std::move(data);
+    if (!font.font.loadFromMemory(font.data.data(), font.data.size())) {
+      throw std::runtime_error("unable to load font");
+    }
+  }
+};
+
+// maps, dialog data
+template<> struct AssetLoader<nlohmann::json>
+{
+  using Decoded = nlohmann::json;
+
+  static Decoded decode(const std::filesystem::path &path, const AssetDiskCache * /*cache*/)
+  {
+    std::ifstream ifs(path);
+    if (!ifs) { throw std::runtime_error("unable to open: " + path.string()); }
+    return nlohmann::json::parse(ifs);
+  }
+
+  static void upload(Decoded &&json, nlohmann::json &value) { value = std::move(json); }
+};
+
+// recorded event streams for --replay
+template<> struct AssetLoader<std::vector<GameState::Event>>
+{
+  using Decoded = std::vector<GameState::Event>;
+
+  static Decoded decode(const std::filesystem::path &path, const AssetDiskCache *cache)
+  {
+    return AssetLoader<nlohmann::json>::decode(path, cache).get<std::vector<GameState::Event>>();
+  }
+
+  static void upload(Decoded &&events, std::vector<GameState::Event> &value) { value = std::move(events); }
+};
+
+namespace detail {
+  template<typename T> struct AssetSlot
+  {
+    explicit AssetSlot(std::filesystem::path assetPath) : path{ std::move(assetPath) } {}
+
+    std::filesystem::path   path;
+    std::atomic<AssetState> state{ AssetState::Loading };
+    std::optional<T>        value;// set before state becomes Ready
+    std::string             error;// set before state becomes Failed
+
+    void fail(std::string message)
+    {
+      error = std::move(message);
+      state = AssetState::Failed;
+      state.notify_all();
+    }
+  };
+}// namespace detail
+
+// Shared handle to an asset, the asset stays cached as long as a handle exists.
+template<typename T> class Asset
+{
+public:
+  Asset() = default;
+
+  [[nodiscard]] AssetState state() const noexcept { return slot ? slot->state.load() : AssetState::Failed; }
+  [[nodiscard]] bool       ready() const noexcept { return state() == AssetState::Ready; }
+
+  // false for a default constructed handle, which never loads anything
+  [[nodiscard]] bool empty() const noexcept { return !slot; }
+
+  [[nodiscard]] const T &get() const
+  {
+    if (!ready()) { throw std::logic_error("asset is not ready: " + path().string()); }
+    return *slot->value;
+  }
+
+  [[nodiscard]] const std::filesystem::path &path() const { return checkedSlot().path; }
+  [[nodiscard]] const std::string &          error() const { return checkedSlot().error; }
+
+private:
+  friend class AssetManager;
+  explicit Asset(std::shared_ptr<detail::AssetSlot<T>> assetSlot) : slot{ std::move(assetSlot) } {}
+
+  [[nodiscard]] const detail::AssetSlot<T> &checkedSlot() const
+  {
+    if (!slot) { throw std::logic_error("empty asset handle"); }
+    return *slot;
+  }
+
+  std::shared_ptr<detail::AssetSlot<T>> slot;
+};
+
+// Decodes assets on the ThreadPool, deduplicates them by path and finishes
+// GPU uploads on the main thread in time budgeted batches.
+class AssetManager
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit AssetManager(ThreadPool &threadPool, const std::optional<std::filesystem::path> &cacheDirectory = {})
+    : pool{ threadPool }, shared{ std::make_shared<Shared>() }
+  {
+    if (cacheDirectory) { shared->diskCache.emplace(*cacheDirectory); }
+  }
+
+  template<typename T> [[nodiscard]] Asset<T> load(const std::filesystem::path &path)
+  {
+    const auto key = std::make_pair(std::type_index{ typeid(T) }, path.lexically_normal().string());
+    if (const auto found = cache.find(key); found != cache.end()) {
+      return Asset<T>{ std::static_pointer_cast<detail::AssetSlot<T>>(found->second) };
+    }
+
+    auto slot = std::make_shared<detail::AssetSlot<T>>(path);
+    cache.emplace(key, slot);
+
+    pool.submit([slot, state = shared]() {
+      try {
+        const auto *diskCache = state->diskCache ? &*state->diskCache : nullptr;
+        auto decoded =
+          std::make_shared<typename AssetLoader<T>::Decoded>(AssetLoader<T>::decode(slot->path, diskCache));
+
+        // published before the upload is queued so it can not overwrite Ready
+        slot->state = AssetState::Uploading;
+        slot->state.notify_all();
+
+        state->enqueueUpload([slot, decoded]() {
+          try {
+            slot->value.emplace();
+            AssetLoader<T>::upload(std::move(*decoded), *slot->value);
+            slot->state = AssetState::Ready;
+            slot->state.notify_all();
+          } catch (const std::exception &e) {
+            slot->value.reset();
+            slot->fail(e.what());
+          }
+        });
+      } catch (const std::exception &e) {
+        slot->fail(e.what());
+      }
+    });
+
+    return Asset<T>{ std::move(slot) };
+  }
+
+  // Runs finished uploads until budget is spent, at least one per call.
+  // Must be called on the thread that owns the window.
+  std::size_t uploadPending(const std::chrono::microseconds budget)
+  {
+    const auto  deadline = clock::now() + budget;
+    std::size_t uploaded = 0;
+    while (auto upload = shared->popUpload()) {
+      (*upload)();
+      ++uploaded;
+      if (clock::now() >= deadline) { break; }
+    }
+    return uploaded;
+  }
+
+  // blocks until the asset is ready, running uploads meanwhile; throws if loading failed
+  template<typename T> const T &wait(const Asset<T> &asset)
+  {
+    if (asset.empty()) { throw std::logic_error("waiting on an empty asset handle"); }
+
+    for (auto state = asset.state(); state != AssetState::Ready; state = asset.state()) {
+      switch (state) {
+      case AssetState::Loading:
+        asset.slot->state.wait(AssetState::Loading);
+        break;
+      case AssetState::Uploading:
+        uploadPending(std::chrono::milliseconds{ 1 });
+        break;
+      case AssetState::Failed:
+        throw std::runtime_error("unable to load " + asset.path().string() + ": " + asset.error());
+      case AssetState::Ready:
+        break;
+      }
+    }
+    return asset.get();
+  }
+
+  // drops cached assets that no handle refers to anymore
+  std::size_t collect()
+  {
+    return std::erase_if(cache, [](const auto &entry) { return entry.second.use_count() == 1; });
+  }
+
+  [[nodiscard]] std::size_t cached() const noexcept { return cache.size(); }
+
+  [[nodiscard]] std::size_t pendingUploads() const
+  {
+    std::scoped_lock lock(shared->mutex);
+    return shared->uploads.size();
+  }
+
+private:
+  // state that outlives the manager while workers are still decoding
+  struct Shared
+  {
+    std::mutex                        mutex;
+    std::deque<std::function<void()>> uploads;
+    std::optional<AssetDiskCache>     diskCache;
+
+    void enqueueUpload(std::function<void()> upload)
+    {
+      std::scoped_lock lock(mutex);
+      uploads.push_back(std::move(upload));
+    }
+
+    std::optional<std::function<void()>> popUpload()
+    {
+      std::scoped_lock lock(mutex);
+      if (uploads.empty()) { return {}; }
+      auto upload = std::move(uploads.front());
+      uploads.pop_front();
+      return upload;
+    }
+  };
+
+  ThreadPool &                                                             pool;
+  std::shared_ptr<Shared>                                                  shared;
+  std::map<std::pair<std::type_index, std::string>, std::shared_ptr<void>> cache;
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_ASSETS_HPP
@@ -0,0 +1,639 @@
+#ifndef MYPROJECT_ECS_HPP
+#define MYPROJECT_ECS_HPP
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace Game::ECS {
+
+constexpr std::size_t MaxComponents = 64;
+using ComponentMask                 = std::bitset<MaxComponents>;
+using ComponentId                   = std::uint32_t;
+
+struct Entity
+{
+  std::uint32_t index{ std::numeric_limits<std::uint32_t>::max() };
+  std::uint32_t generation{ 0 };
+
+  [[nodiscard]] constexpr bool operator==(const Entity &) const = default;
+};
+
+struct ComponentInfo
+{
+  std::size_t size;
+  std::size_t align;
+  void (*moveConstruct)(void *dst, void *src);
+  void (*copyConstruct)(void *dst, const void *src);
+  void (*destroy)(void *obj);
+};
+
+namespace detail {
+  struct ComponentRegistry
+  {
+    std::mutex                                mutex;
+    std::array<ComponentInfo, MaxComponents> infos{};
+    ComponentId                               count{ 0 };
+  };
+
+  inline ComponentRegistry &registry()
+  {
+    static ComponentRegistry instance;
+    return instance;
+  }
+
+  template<typename T> ComponentId registerComponent()
+  {
+    static_assert(std::is_nothrow_move_constructible_v<T>, "components are relocated between chunks");
+
+    auto &            reg = registry();
+    std::scoped_lock lock(reg.mutex);
+    if (reg.count == MaxComponents) { throw std::length_error("too many component types"); }
+
+    ComponentInfo info{ sizeof(T),
+                        alignof(T),
+                        [](void *dst, void *src) { new (dst) T(std::move(*static_cast<T *>(src))); },
+                        nullptr,
+                        nullptr };
+
+    if constexpr (std::is_copy_constructible_v<T>) {
+      info.copyConstruct = [](void *dst, const void *src) { new (dst) T(*static_cast<const T *>(src)); };
+    }
+
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      info.destroy = [](void *obj) { static_cast<T *>(obj)->~T(); };
+    }
+
+    reg.infos[reg.count] = info;
+    return reg.count++;
+  }
+}// namespace detail
+
+namespace detail {
+  template<typename T> ComponentId componentId()
+  {
+    static const ComponentId id = registerComponent<T>();
+    return id;
+  }
+}// namespace detail
+
+// const qualified components share the id of the underlying type
+template<typename T> ComponentId componentId() { return detail::componentId<std::remove_cvref_t<T>>(); }
+
+inline const ComponentInfo &componentInfo(const ComponentId id) { return detail::registry().infos[id]; }
+
+template<typename... T> ComponentMask componentMask()
+{
+  ComponentMask mask;
+  (mask.set(componentId<T>()), ...);
+  return mask;
+}
+
+// All entities with exactly the same set of components live in one archetype.
+// Their components are stored column wise (SoA) in fixed size chunks.
+class Archetype
+{
+public:
+  static constexpr std::size_t ChunkBytes = 16 * 1024;
+  static constexpr std::size_t ChunkAlign = 64;
+  static constexpr std::size_t NoColumn   = std::numeric_limits<std::size_t>::max();
+
+  struct Chunk
+  {
+    std::byte * data{ nullptr };
+    std::size_t count{ 0 };
+  };
+
+  explicit Archetype(const ComponentMask &componentMask) : mask{ componentMask }
+  {
+    columnIndex.fill(NoColumn);
+
+    std::size_t rowBytes = sizeof(Entity);
+    for (ComponentId id = 0; id < MaxComponents; ++id) {
+      if (mask.test(id)) {
+        columnIndex[id] = components.size();
+        components.push_back(id);
+        rowBytes += componentInfo(id).size + componentInfo(id).align;
+      }
+    }
+
+    capacity = std::max(ChunkBytes / rowBytes, std::size_t{ 1 });
+
+    // entity handles first, then one aligned column per component
+    std::size_t offset = sizeof(Entity) * capacity;
+    for (const auto id : components) {
+      const auto &info = componentInfo(id);
+      offset           = (offset + info.align - 1) / info.align * info.align;
+      offsets.push_back(offset);
+      offset += info.size * capacity;
+    }
+    chunkBytes = std::max(offset, ChunkAlign);
+  }
+
+  Archetype(const Archetype &other)
+    : mask{ other.mask }, components{ other.components }, columnIndex{ other.columnIndex }, offsets{ other.offsets },
+      capacity{ other.capacity }, chunkBytes{ other.chunkBytes }, entityCount{ other.entityCount }
+  {
+    for (const auto id : components) {
+      if (componentInfo(id).copyConstruct == nullptr) { throw std::logic_error("component type is not copyable"); }
+    }
+
+    // built aside so a throwing copy can not leak chunks or leave rows half built
+    std::vector<Chunk> copied;
+    copied.reserve(other.chunks.size());
+    try {
+      for (const auto &chunk : other.chunks) {
+        auto &copy = copied.emplace_back(Chunk{ allocateChunk(), 0 });
+        std::memcpy(copy.data, chunk.data, sizeof(Entity) * chunk.count);
+        for (; copy.count < chunk.count; ++copy.count) { copyRow(copy, chunk, copy.count); }
+      }
+    } catch (...) {
+      for (const auto &chunk : copied) {
+        destroyRows(chunk, 0, chunk.count);
+        freeChunk(chunk.data);
+      }
+      throw;
+    }
+    chunks = std::move(copied);
+  }
+
+  Archetype(Archetype &&)  = delete;
+  Archetype &operator=(const Archetype &) = delete;
+  Archetype &operator=(Archetype &&) = delete;
+
+  ~Archetype()
+  {
+    for (auto &chunk : chunks) {
+      destroyRows(chunk, 0, chunk.count);
+      freeChunk(chunk.data);
+    }
+  }
+
+  [[nodiscard]] const ComponentMask &     signature() const noexcept { return mask; }
+  [[nodiscard]] std::size_t               size() const noexcept { return entityCount; }
+  [[nodiscard]] std::size_t               chunkCapacity() const noexcept { return capacity; }
+  [[nodiscard]] const std::vector<Chunk> &chunkList() const noexcept { return chunks; }
+  [[nodiscard]] bool                      has(const ComponentId id) const noexcept { return mask.test(id); }
+
+  [[nodiscard]] std::byte *column(const Chunk &chunk, const ComponentId id) const
+  {
+    assert(columnIndex[id] != NoColumn);
+    return chunk.data + offsets[columnIndex[id]];
+  }
+
+  template<typename T> [[nodiscard]] T *column(const Chunk &chunk) const
+  {
+    return std::launder(reinterpret_cast<T *>(column(chunk, componentId<T>())));
+  }
+
+  [[nodiscard]] static Entity *entities(const Chunk &chunk) { return reinterpret_cast<Entity *>(chunk.data); }
+
+  [[nodiscard]] void *component(const std::size_t chunk, const std::size_t row, const ComponentId id) const
+  {
+    return column(chunks[chunk], id) + row * componentInfo(id).size;
+  }
+
+  // reserves a row, the caller must construct every component in it
+  std::pair<std::size_t, std::size_t> allocateRow(const Entity entity)
+  {
+    if (chunks.empty() || chunks.back().count == capacity) { chunks.push_back(Chunk{ allocateChunk(), 0 }); }
+
+    auto &     chunk = chunks.back();
+    const auto row   = chunk.count++;
+    entities(chunk)[row] = entity;
+    ++entityCount;
+    return { chunks.size() - 1, row };
+  }
+
+  // Removes a row by moving the last row of the archetype into it.
+  // Returns the entity that now lives in the freed row, if any.
+  Entity removeRow(const std::size_t chunkIndex, const std::size_t row)
+  {
+    auto &chunk = chunks[chunkIndex];
+    for (const auto id : components) {
+      if (const auto &info = componentInfo(id); info.destroy != nullptr) {
+        info.destroy(component(chunkIndex, row, id));
+      }
+    }
+
+    auto &     last    = chunks.back();
+    const auto lastRow = last.count - 1;
+    Entity     moved{};
+
+    if (&last != &chunk || lastRow != row) {
+      moved = entities(last)[lastRow];
+      for (const auto id : components) {
+        const auto &info = componentInfo(id);
+        info.moveConstruct(component(chunkIndex, row, id), component(chunks.size() - 1, lastRow, id));
+        if (info.destroy != nullptr) { info.destroy(component(chunks.size() - 1, lastRow, id)); }
+      }
+      entities(chunk)[row] = moved;
+    }
+
+    --last.count;
+    --entityCount;
+
+    if (last.count == 0) {
+      freeChunk(last.data);
+      chunks.pop_back();
+    }
+    return moved;
+  }
+
+private:
+  [[nodiscard]] std::byte *allocateChunk() const
+  {
+    return static_cast<std::byte *>(::operator new(chunkBytes, std::align_val_t{ ChunkAlign }));
+  }
+
+  static void freeChunk(std::byte *data) { ::operator delete(data, std::align_val_t{ ChunkAlign }); }
+
+  // copies every component of one row, destroying the ones already copied if a copy throws
+  void copyRow(const Chunk &target, const Chunk &source, const std::size_t row) const
+  {
+    std::size_t column = 0;
+    try {
+      for (; column < components.size(); ++column) {
+        const auto offset = offsets[column] + row * componentInfo(components[column]).size;
+        componentInfo(components[column]).copyConstruct(target.data + offset, source.data + offset);
+      }
+    } catch (...) {
+      while (column-- > 0) {
+        const auto &info = componentInfo(components[column]);
+        if (info.destroy != nullptr) { info.destroy(target.data + offsets[column] + row * info.size); }
+      }
+      throw;
+    }
+  }
+
+  void destroyRows(const Chunk &chunk, const std::size_t begin, const std::size_t end) const
+  {
+    for (std::size_t column = 0; column < components.size(); ++column) {
+      const auto &info = componentInfo(components[column]);
+      if (info.destroy == nullptr) { continue; }
+      for (std::size_t row = begin; row < end; ++row) { info.destroy(chunk.data + offsets[column] + row * info.size); }
+    }
+  }
+
+  ComponentMask                           mask;
+  std::vector<ComponentId>                components;
+  std::array<std::size_t, MaxComponents> columnIndex{};
+  std::vector<std::size_t>                offsets;
+  std::size_t                             capacity{ 0 };
+  std::size_t                             chunkBytes{ 0 };
+  std::size_t                             entityCount{ 0 };
+  std::vector<Chunk>                      chunks;
+};
+
+class World
+{
+public:
+  World() = default;
+
+  World(const World &other)
+    : records{ other.records }, freeIndices{ other.freeIndices }, archetypeLookup{ other.archetypeLookup }
+  {
+    archetypes.reserve(other.archetypes.size());
+    for (const auto &archetype : other.archetypes) { archetypes.push_back(std::make_unique<Archetype>(*archetype)); }
+  }
+
+  World(World &&) noexcept = default;
+  World &operator=(World &&) noexcept = default;
+
+  World &operator=(const World &other)
+  {
+    if (this != &other) { *this = World{ other }; }
+    return *this;
+  }
+
+  ~World() = default;
+
+  template<typename... T> Entity create(T &&... components)
+  {
+    const auto entity = allocateEntity();
+    auto &     record = records[entity.index];
+
+    record.archetype           = archetypeFor(componentMask<T...>());
+    auto &archetype            = *archetypes[record.archetype];
+    std::tie(record.chunk, record.row) = archetype.allocateRow(entity);
+
+    (new (archetype.component(record.chunk, record.row, componentId<T>()))
+        std::remove_cvref_t<T>(std::forward<T>(components)),
+      ...);
+
+    return entity;
+  }
+
+  void destroy(const Entity entity)
+  {
+    if (!alive(entity)) { return; }
+
+    auto &record = records[entity.index];
+    if (record.archetype != NoArchetype) {
+      const auto moved = archetypes[record.archetype]->removeRow(record.chunk, record.row);
+      if (moved.index != Entity{}.index) {
+        records[moved.index].chunk = record.chunk;
+        records[moved.index].row   = record.row;
+      }
+    }
+
+    record.archetype = Dead;
+    ++record.generation;
+    freeIndices.push_back(entity.index);
+  }
+
+  [[nodiscard]] bool alive(const Entity entity) const noexcept
+  {
+    return entity.index < records.size() && records[entity.index].generation == entity.generation
+           && records[entity.index].archetype != Dead;
+  }
+
+  template<typename T> [[nodiscard]] bool has(const Entity entity) const
+  {
+    return alive(entity) && records[entity.index].archetype != NoArchetype
+           && archetypes[records[entity.index].archetype]->has(componentId<T>());
+  }
+
+  template<typename T> [[nodiscard]] T *get(const Entity entity)
+  {
+    if (!has<T>(entity)) { return nullptr; }
+    const auto &record = records[entity.index];
+    return std::launder(
+      static_cast<T *>(archetypes[record.archetype]->component(record.chunk, record.row, componentId<T>())));
+  }
+
+  template<typename T> [[nodiscard]] const T *get(const Entity entity) const
+  {
+    return const_cast<World *>(this)->get<T>(entity);
+  }
+
+  // adds or replaces a component, moving the entity to a new archetype if needed
+  template<typename T> T &add(const Entity entity, T &&value)
+  {
+    using Component = std::remove_cvref_t<T>;
+    if (!alive(entity)) { throw std::logic_error("entity is not alive"); }
+
+    if (auto *existing = get<Component>(entity); existing != nullptr) {
+      *existing = std::forward<T>(value);
+      return *existing;
+    }
+
+    const auto id = componentId<Component>();
+    move(entity, signature(entity) | componentMask<Component>());
+
+    auto &record = records[entity.index];
+    return *new (archetypes[record.archetype]->component(record.chunk, record.row, id))
+      Component(std::forward<T>(value));
+  }
+
+  template<typename T> void remove(const Entity entity)
+  {
+    if (!has<T>(entity)) { return; }
+    auto mask = signature(entity);
+    mask.reset(componentId<T>());
+    move(entity, mask);
+  }
+
+  // calls func(T &...) or func(Entity, T &...) for every entity that has all of T
+  template<typename... T, typename Func> void each(Func &&func)
+  {
+    eachChunk<T...>([&func](const std::size_t count, const Entity *entities, T *... columns) {
+      for (std::size_t row = 0; row < count; ++row) {
+        if constexpr (std::is_invocable_v<Func &, Entity, T &...>) {
+          func(entities[row], columns[row]...);
+        } else {
+          func(columns[row]...);
+        }
+      }
+    });
+  }
+
+  // calls func(count, entities, T *...) once per chunk, columns are contiguous
+  template<typename... T, typename Func> void eachChunk(Func &&func)
+  {
+    const auto mask = componentMask<T...>();
+    for (const auto &archetype : archetypes) {
+      if ((archetype->signature() & mask) != mask) { continue; }
+      for (const auto &chunk : archetype->chunkList()) {
+        func(chunk.count, Archetype::entities(chunk), archetype->column<T>(chunk)...);
+      }
+    }
+  }
+
+  // like each, but chunks are spread across the pool. func must only touch its own entities.
+  template<typename... T, typename Func> void parallelEach(ThreadPool &pool, Func &&func)
+  {
+    std::vector<std::pair<const Archetype *, const Archetype::Chunk *>> work;
+    const auto                                                         mask = componentMask<T...>();
+    for (const auto &archetype : archetypes) {
+      if ((archetype->signature() & mask) != mask) { continue; }
+      for (const auto &chunk : archetype->chunkList()) { work.emplace_back(archetype.get(), &chunk); }
+    }
+
+    pool.parallelFor(work.size(), 1, [&](const std::size_t begin, const std::size_t end) {
+      for (auto index = begin; index < end; ++index) {
+        const auto [archetype, chunk] = work[index];
+        const auto *entities          = Archetype::entities(*chunk);
+        const auto  columns           = std::make_tuple(archetype->column<T>(*chunk)...);
+        for (std::size_t row = 0; row < chunk->count; ++row) {
+          std::apply(
+            [&](T *... column) {
+              if constexpr (std::is_invocable_v<Func &, Entity, T &...>) {
+                func(entities[row], column[row]...);
+              } else {
+                func(column[row]...);
+              }
+            },
+            columns);
+        }
+      }
+    });
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return records.size() - freeIndices.size(); }
+  [[nodiscard]] std::size_t archetypeCount() const noexcept { return archetypes.size(); }
+
+private:
+  static constexpr std::uint32_t NoArchetype = std::numeric_limits<std::uint32_t>::max();
+  static constexpr std::uint32_t Dead        = NoArchetype - 1;
+
+  struct Record
+  {
+    std::uint32_t archetype{ Dead };
+    std::uint32_t generation{ 0 };
+    std::size_t   chunk{ 0 };
+    std::size_t   row{ 0 };
+  };
+
+  Entity allocateEntity()
+  {
+    if (!freeIndices.empty()) {
+      const auto index = freeIndices.back();
+      freeIndices.pop_back();
+      records[index].archetype = NoArchetype;
+      return { index, records[index].generation };
+    }
+
+    if (records.size() == std::numeric_limits<std::uint32_t>::max()) { throw std::length_error("too many entities"); }
+    records.push_back(Record{ NoArchetype, 0, 0, 0 });
+    return { static_cast<std::uint32_t>(records.size() - 1), 0 };
+  }
+
+  [[nodiscard]] ComponentMask signature(const Entity entity) const
+  {
+    const auto archetype = records[entity.index].archetype;
+    return archetype == NoArchetype ? ComponentMask{} : archetypes[archetype]->signature();
+  }
+
+  std::uint32_t archetypeFor(const ComponentMask &mask)
+  {
+    if (mask.none()) { return NoArchetype; }
+
+    if (const auto found = archetypeLookup.find(mask); found != archetypeLookup.end()) { return found->second; }
+
+    archetypes.push_back(std::make_unique<Archetype>(mask));
+    const auto index = static_cast<std::uint32_t>(archetypes.size() - 1);
+    archetypeLookup.emplace(mask, index);
+    return index;
+  }
+
+  // relocates the shared components of entity into the archetype for mask,
+  // components not in mask are destroyed and new ones are left unconstructed
+  void move(const Entity entity, const ComponentMask &mask)
+  {
+    auto &     record = records[entity.index];
+    const auto from   = record.archetype;
+    const auto to     = archetypeFor(mask);
+    if (from == to) { return; }
+
+    std::size_t chunk = 0;
+    std::size_t row   = 0;
+    if (to != NoArchetype) {
+      std::tie(chunk, row) = archetypes[to]->allocateRow(entity);
+      if (from != NoArchetype) {
+        for (ComponentId id = 0; id < MaxComponents; ++id) {
+          if (mask.test(id) && archetypes[from]->has(id)) {
+            componentInfo(id).moveConstruct(
+              archetypes[to]->component(chunk, row, id), archetypes[from]->component(record.chunk, record.row, id));
+          }
+        }
+      }
+    }
+
+    if (from != NoArchetype) {
+      const auto moved = archetypes[from]->removeRow(record.chunk, record.row);
+      if (moved.index != Entity{}.index) {
+        records[moved.index].chunk = record.chunk;
+        records[moved.index].row   = record.row;
+      }
+    }
+
+    record.archetype = to;
+    record.chunk     = chunk;
+    record.row       = row;
+  }
+
+  std::vector<Record>                            records;
+  std::vector<std::uint32_t>                     freeIndices;
+  std::unordered_map<ComponentMask, std::uint32_t> archetypeLookup;
+  std::vector<std::unique_ptr<Archetype>>        archetypes;
+};
+
+// Declares which components a system reads and writes. Systems that write a
+// component conflict with every other system touching it.
+struct Access
+{
+  ComponentMask reads;
+  ComponentMask writes;
+  bool          exclusive{ false };// structural changes: create, destroy, add, remove
+
+  template<typename... T> Access &read()
+  {
+    reads |= componentMask<T...>();
+    return *this;
+  }
+
+  template<typename... T> Access &write()
+  {
+    writes |= componentMask<T...>();
+    return *this;
+  }
+
+  Access &structural()
+  {
+    exclusive = true;
+    return *this;
+  }
+
+  [[nodiscard]] bool conflictsWith(const Access &other) const
+  {
+    return exclusive || other.exclusive || (writes & (other.reads | other.writes)).any()
+           || (other.writes & reads).any();
+  }
+};
+
+// Runs systems in the order they were added, except that systems without
+// conflicting access are grouped into stages that run in parallel.
+class Scheduler
+{
+public:
+  using SystemFunc = std::function<void(World &)>;
+
+  struct System
+  {
+    std::string name;
+    Access      access;
+    SystemFunc  func;
+    std::size_t stage{ 0 };
+  };
+
+  void add(std::string name, Access access, SystemFunc func)
+  {
+    System system{ std::move(name), access, std::move(func), 0 };
+    for (const auto &previous : systems) {
+      if (previous.access.conflictsWith(system.access)) { system.stage = std::max(system.stage, previous.stage + 1); }
+    }
+
+    if (system.stage >= stages.size()) { stages.resize(system.stage + 1); }
+    stages[system.stage].push_back(systems.size());
+    systems.push_back(std::move(system));
+  }
+
+  void run(World &world, ThreadPool &pool) const
+  {
+    for (const auto &stage : stages) {
+      pool.parallelFor(stage.size(), 1, [&](const std::size_t begin, const std::size_t end) {
+        for (auto index = begin; index < end; ++index) { systems[stage[index]].func(world); }
+      });
+    }
+  }
+
+  [[nodiscard]] const std::vector<System> &                  systemList() const noexcept { return systems; }
+  [[nodiscard]] const std::vector<std::vector<std::size_t>> &stageList() const noexcept { return stages; }
+
+private:
+  std::vector<System>                   systems;
+  std::vector<std::vector<std::size_t>> stages;
+};
+
+}// namespace Game::ECS
+
+#endif// MYPROJECT_ECS_HPP
@@ -0,0 +1,466 @@
+#ifndef MYPROJECT_GAMELOOP_HPP
+#define MYPROJECT_GAMELOOP_HPP
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Time.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <imgui.h>
+
+#include "AllocationTracker.hpp"
+#include "Assets.hpp"
+#include "ImGuiHelpers.hpp"
+#include "Input.hpp"
+#include "Rollback.hpp"
+#include "SpriteBatch.hpp"
+#include "ThreadPool.hpp"
+#include "Utility.hpp"
+
+namespace Game {
+
+// Everything the game does per event and per frame except talking to the
+// window: main.cpp wraps it with SFML and ImGui-SFML, the allocation tests
+// drive the same code without a window.
+class GameLoop
+{
+public:
+  using Event          = GameState::Event;
+  using NetplaySession = RollbackSession<Simulation, std::vector<Event>>;
+
+  GameLoop(GameState &                   localState,
+    ThreadPool &                         threadPool,
+    AssetManager &                       assetManager,
+    const sf::Vector2f                   viewSize,
+    std::optional<std::filesystem::path> latencyLogFile,
+    const AssetManager::clock::time_point startTime = AssetManager::clock::now())
+    : gs{ localState }, pool{ threadPool }, assets{ assetManager }, view{ viewSize },
+      latencyLog{ std::move(latencyLogFile) }, started{ startTime }
+  {
+    // built once, formatting the labels every frame would allocate
+    for (std::size_t index = 0; const auto &step : steps) {
+      stepLabels.at(index) = fmt::format("{} : {}", index, step);
+      ++index;
+    }
+
+    addSystems(gs.systems);
+    buildMap(gs.simulation);
+  }
+
+  GameLoop(const GameLoop &) = delete;
+  GameLoop(GameLoop &&)      = delete;
+  GameLoop &operator=(const GameLoop &) = delete;
+  GameLoop &operator=(GameLoop &&) = delete;
+  ~GameLoop()                      = default;
+
+  // Rollback netplay with peer. The session starts from, and from then on
+  // owns, gs.simulation; gs only handles local input and timing. Both peers
+  // build the same map, so call this before any event has touched it.
+  void startNetplay(Transport &peer, const std::size_t player)
+  {
+    using MouseMoved   = GameState::Moved<GameState::Mouse>;
+    using MousePressed = GameState::Pressed<GameState::MouseButton>;
+
+    // joystick events are left out, GameState::joystickById reads the local hardware
+    auto simulate = [&systems = gs.systems, &workers = pool](Simulation &state, const NetplaySession::Inputs &inputs) {
+      for (const auto &playerEvents : inputs) {
+        for (const auto &playerEvent : playerEvents) {
+          std::visit(overloaded{ [&](const MouseMoved &mouse) { state.hover(mouse.source.x, mouse.source.y); },
+                       [&](const MousePressed &button) { state.select(button.source.mouse.x, button.source.mouse.y); },
+                       [](const auto &) {} },
+            playerEvent);
+        }
+      }
+      state.step(systems, workers);
+    };
+
+    netplay = std::make_unique<NetplaySession>(gs.simulation, player, peer, std::move(simulate));
+  }
+
+  // soft edged discs of a few sizes tinted per sprite, needs the GL context
+  void spawnStressSprites(const std::size_t count)
+  {
+    std::vector<AtlasRegion> regions;
+    for (unsigned size = 8; size <= 64; size += 4) {
+      sf::Image  image;
+      const auto radius = static_cast<float>(size) / 2.F;
+      image.create(size, size, sf::Color::Transparent);
+      for (unsigned y = 0; y < size; ++y) {
+        for (unsigned x = 0; x < size; ++x) {
+          const auto dx       = static_cast<float>(x) + 0.5F - radius;
+          const auto dy       = static_cast<float>(y) + 0.5F - radius;
+          const auto coverage = std::clamp(radius - std::sqrt(dx * dx + dy * dy), 0.F, 1.F);
+          image.setPixel(x, y, sf::Color(255, 255, 255, static_cast<sf::Uint8>(coverage * 255.F)));
+        }
+      }
+      regions.push_back(atlas.add(image));
+    }
+
+    std::mt19937                               rng{ 5489 };
+    std::uniform_real_distribution<float>      xs{ 0.F, view.x };
+    std::uniform_real_distribution<float>      ys{ 0.F, view.y };
+    std::uniform_real_distribution<float>      speeds{ -120.F, 120.F };
+    std::uniform_real_distribution<float>      spins{ -180.F, 180.F };
+    std::uniform_int_distribution<int>         channels{ 64, 255 };
+    std::uniform_int_distribution<int>         layers{ 0, 3 };
+    std::uniform_int_distribution<std::size_t> regionIndex{ 0, regions.size() - 1 };
+
+    stressSprites.reserve(stressSprites.size() + count);
+    for (std::size_t index = 0; index < count; ++index) {
+      const auto &region  = regions[regionIndex(rng)];
+      const auto  half    = static_cast<float>(region.rect.width) / 2.F;
+      const auto  channel = [&]() { return static_cast<sf::Uint8>(channels(rng)); };
+
+      StressSprite sprite;
+      sprite.draw.region   = region;
+      sprite.draw.position = { xs(rng), ys(rng) };
+      sprite.draw.origin   = { half, half };
+      sprite.draw.color    = sf::Color(channel(), channel(), channel());
+      sprite.draw.layer    = static_cast<std::int16_t>(layers(rng));
+      sprite.velocity      = { speeds(rng), speeds(rng) };
+      sprite.spin          = spins(rng);
+      stressSprites.push_back(sprite);
+    }
+  }
+
+  // Records and applies one event. Returns the elapsed time when the event
+  // ends a frame; the caller then starts an ImGui frame and calls frame().
+  std::optional<sf::Time> handle(const Event &event)
+  {
+    std::visit(overloaded{ [](GameState::TimeElapsed &prev, const GameState::TimeElapsed &next) {
+                            prev.elapsed += next.elapsed;
+                          },
+                 [&](const auto & /*prev*/, const std::monostate &) {},
+                 [&](const auto & /*prev*/, const auto &next) { events.push_back(next); } },
+      events.back(),
+      event);
+
+    ++eventsProcessed;
+
+    if (netplay && GameState::inputSource(event)) { netplayInputs.push_back(event); }
+
+    std::optional<sf::Time> elapsed;
+
+    std::visit(overloaded{ [&](const JoystickEvent auto &jsEvent) {
+                            gs.update(jsEvent);
+                            joystickEvent = true;
+                          },
+                 [&](const GameState::Moved<GameState::Mouse> &mouse) {
+                   if (!netplay) { gs.update(mouse); }
+                 },
+                 [&](const GameState::Pressed<GameState::MouseButton> &button) {
+                   if (!netplay) { gs.update(button); }
+                 },
+                 [&](const GameState::CloseWindow & /*unused*/) { closing = true; },
+                 [&](const GameState::TimeElapsed &te) {
+                   if (!netplay) {
+                     gs.step(pool);
+                   } else if (netplay->advance(netplayInputs)) {
+                     netplayInputs.clear();
+                   }
+                   elapsed = te.toSFMLTime();
+                 },
+                 [&](const auto & /*do nothing*/) {} },
+      event);
+
+    return elapsed;
+  }
+
+  // Everything between starting and rendering an ImGui frame: uploads,
+  // sprite updates and the UI.
+  void frame(const sf::Time elapsed)
+  {
+    assets.uploadPending(std::chrono::milliseconds{ 2 });
+    // assets whose last handle went away are evicted here
+    assets.collect();
+
+    moveStressSprites(elapsed.asSeconds());
+
+    ImGui::Begin("The Plan");
+
+    for (std::size_t index = 0; index < steps.size(); ++index) {
+      ImGui::Checkbox(stepLabels.at(index).c_str(), &states.at(index));
+    }
+
+    ImGui::End();
+
+    ImGui::Begin("Joystick");
+
+    if (!gs.joySticks.empty()) {
+      ImGuiHelper::Text("Joystick Event: {}", joystickEvent);
+      joystickEvent = false;
+      for (std::size_t button = 0; button < gs.joySticks[0].buttonCount; ++button) {
+        ImGuiHelper::Text("{}: {}", button, gs.joySticks[0].buttonState[button]);
+      }
+
+      for (std::size_t axis = 0; axis < sf::Joystick::AxisCount; ++axis) {
+        ImGuiHelper::Text(
+          "{}: {}", toString(static_cast<sf::Joystick::Axis>(axis)), gs.joySticks[0].axisPosition[axis]);
+      }
+    }
+
+    ImGui::End();
+
+    ImGui::Begin("World");
+
+    const auto &shown = simulation();
+    ImGuiHelper::Text("Entities: {} Map objects: {}", shown.world.size(), shown.worldIndex.size());
+    ImGuiHelper::Text("Hovered: {}", shown.hovered ? static_cast<std::int64_t>(shown.hovered->index) : -1);
+    ImGuiHelper::Text("Selected: {}", shown.selected ? static_cast<std::int64_t>(shown.selected->index) : -1);
+
+    ImGui::End();
+
+    ImGui::Begin("Assets");
+
+    ImGuiHelper::Text("Cached: {} Pending uploads: {}", assets.cached(), assets.pendingUploads());
+    if (firstFrame) {
+      ImGuiHelper::Text(
+        "Time to first frame: {}ms", std::chrono::duration_cast<std::chrono::milliseconds>(*firstFrame).count());
+    }
+
+    ImGui::End();
+
+    if (netplay) {
+      ImGui::Begin("Netplay");
+
+      const auto &stats = netplay->stats();
+      ImGuiHelper::Text("Tick: {} Confirmed: {}", netplay->currentTick(), netplay->confirmedTick());
+      ImGuiHelper::Text("Rollbacks: {} Resimulated ticks: {} Stalls: {}",
+        stats.rollbacks,
+        stats.resimulatedTicks,
+        stats.stalls);
+      ImGuiHelper::Text("Resimulation last: {}us max: {}us",
+        std::chrono::duration_cast<std::chrono::microseconds>(stats.lastResimulation).count(),
+        std::chrono::duration_cast<std::chrono::microseconds>(stats.maxResimulation).count());
+      ImGuiHelper::Text("Packets sent: {} received: {} rejected: {}",
+        stats.packetsSent,
+        stats.packetsReceived,
+        stats.packetsRejected);
+
+      ImGui::End();
+    }
+
+    ImGui::Begin("Sprites");
+
+    // the batch is drawn after the UI is built, so these are the previous frame's numbers
+    const auto &spriteStats = spriteBatch.stats();
+    ImGuiHelper::Text(
+      "Sprites: {} Draw calls: {} Vertices: {}", spriteStats.sprites, spriteStats.drawCalls, spriteStats.vertices);
+    ImGuiHelper::Text("Batch build: {}us Atlas pages: {}",
+      std::chrono::duration_cast<std::chrono::microseconds>(spriteStats.build).count(),
+      atlas.pageCount());
+
+    ImGui::End();
+
+    ImGui::Begin("Input Latency");
+
+    ImGuiHelper::Text("Frames: {} Dropped stamps: {}", gs.latency.frames, gs.latency.dropped);
+    for (const auto source : { InputSource::Key, InputSource::Mouse, InputSource::Joystick }) {
+      const auto &histogram = gs.latency.histogram(source);
+      ImGuiHelper::Text("{}: n={} p50={}us p95={}us p99={}us max={}us",
+        toString(source),
+        histogram.count,
+        histogram.percentile(0.50),
+        histogram.percentile(0.95),
+        histogram.percentile(0.99),
+        histogram.max);
+    }
+
+    if (latencyLog) {
+      if (ImGui::Button("Dump")) { dumpLatency(); }
+      ImGui::SameLine();
+    }
+    if (ImGui::Button("Reset")) { gs.latency.reset(); }
+
+    ImGui::End();
+
+#ifdef GAME_TRACK_ALLOCATIONS
+    ImGui::Begin("Allocations");
+
+    const auto allocationTotals = Allocations::total();
+    ImGuiHelper::Text("Last frame: {} allocations, {} frees, {} bytes",
+      lastFrameAllocations.allocations,
+      lastFrameAllocations.deallocations,
+      lastFrameAllocations.bytes);
+    ImGuiHelper::Text("Total: {} allocations, {} frees, {} bytes",
+      allocationTotals.allocations,
+      allocationTotals.deallocations,
+      allocationTotals.bytes);
+
+    if (ImGui::Button("Refresh sites")) {
+      std::array<Allocations::Site, 16> top{};
+      const auto                        found = Allocations::topSites(top);
+      allocationSites.clear();
+      for (std::size_t index = 0; index < found; ++index) {
+        allocationSites.emplace_back(top.at(index), Allocations::describe(top.at(index).address));
+      }
+    }
+
+    for (const auto &[site, name] : allocationSites) {
+      ImGuiHelper::Text("{:>8} {:>10}B {}", site.allocations, site.bytes, name);
+    }
+
+    ImGui::End();
+#endif
+  }
+
+  // once the frame is on screen, returns true for the very first one
+  bool presented()
+  {
+    gs.latency.presented();
+#ifdef GAME_TRACK_ALLOCATIONS
+    lastFrameAllocations = Allocations::endFrame();
+#endif
+
+    if (firstFrame) { return false; }
+    firstFrame = AssetManager::clock::now() - started;
+    return true;
+  }
+
+  // writes the latency histograms, if there is a file to write them to
+  void dumpLatency() const
+  {
+    if (!latencyLog) { return; }
+    std::ofstream ofs{ *latencyLog };
+    gs.latency.dump(ofs);
+  }
+
+  // the state on screen: the netplay session's when there is one
+  [[nodiscard]] const Simulation &simulation() const noexcept { return netplay ? netplay->state() : gs.simulation; }
+
+  [[nodiscard]] bool                      closeRequested() const noexcept { return closing; }
+  [[nodiscard]] std::uint64_t             processed() const noexcept { return eventsProcessed; }
+  [[nodiscard]] const std::vector<Event> &recorded() const noexcept { return events; }
+  [[nodiscard]] SpriteBatch &             sprites() noexcept { return spriteBatch; }
+
+  [[nodiscard]] std::optional<AssetManager::clock::duration> timeToFirstFrame() const noexcept { return firstFrame; }
+
+#ifdef GAME_TRACK_ALLOCATIONS
+  [[nodiscard]] const Allocations::Counters &frameAllocations() const noexcept { return lastFrameAllocations; }
+#endif
+
+private:
+  static constexpr std::array steps = { "The Plan",
+    "Getting Started",
+    "Finding Errors As Soon As Possible",
+    "Handling Command Line Parameters",
+    "Reading SFML Joystick States",
+    "Displaying Joystick States",
+    "Dealing With Game Events",
+    "Reading SFML Keyboard States",
+    "Reading SFML Mouse States",
+    "Reading SFML Touchscreen States",
+    "C++ 20 So Far",
+    "Managing Game State",
+    "Making Our Game Testable",
+    "Making Game State Allocator Aware",
+    "Add Logging To Game Engine",
+    "Draw A Game Map",
+    "Dialog Trees",
+    "Porting From SFML To SDL" };
+
+  static void addSystems(ECS::Scheduler &systems)
+  {
+    using Drift     = Simulation::Drift;
+    using MapObject = Simulation::MapObject;
+
+    systems.add("drift", ECS::Access{}.write<MapObject, Drift>(), [](ECS::World &world) {
+      world.each<MapObject, Drift>([](MapObject &object, Drift &drift) {
+        if (object.bounds.minX + drift.speed < drift.minX || object.bounds.minX + drift.speed > drift.maxX) {
+          drift.speed = -drift.speed;
+        }
+        object.bounds.minX += drift.speed;
+        object.bounds.maxX += drift.speed;
+      });
+    });
+  }
+
+  // a fixed grid of crates, every fourth one drifting within its slot; the
+  // same on every peer, whatever the window size
+  static void buildMap(Simulation &state)
+  {
+    constexpr int Spacing = 64;
+    constexpr int Size    = 48;
+
+    for (int x = 0; x < Simulation::MapWidth; x += Spacing) {
+      for (int y = 0; y < Simulation::MapHeight; y += Spacing) {
+        const auto left   = static_cast<float>(x);
+        const auto entity = state.addMapObject(AABB{ left,
+          static_cast<float>(y),
+          static_cast<float>(x + Size),
+          static_cast<float>(y + Size) });
+        if ((x + y) / Spacing % 4 == 0) {
+          state.world.add(entity, Simulation::Drift{ 0.5F, left, left + static_cast<float>(Spacing - Size) });
+        }
+      }
+    }
+  }
+
+  struct StressSprite
+  {
+    SpriteDraw   draw;
+    sf::Vector2f velocity;
+    float        spin{ 0.F };
+  };
+
+  void moveStressSprites(const float seconds)
+  {
+    for (auto &sprite : stressSprites) {
+      auto &position = sprite.draw.position;
+      position.x += sprite.velocity.x * seconds;
+      position.y += sprite.velocity.y * seconds;
+      // bounce off the window edges
+      if (position.x < 0.F) { sprite.velocity.x = std::abs(sprite.velocity.x); }
+      if (position.x > view.x) { sprite.velocity.x = -std::abs(sprite.velocity.x); }
+      if (position.y < 0.F) { sprite.velocity.y = std::abs(sprite.velocity.y); }
+      if (position.y > view.y) { sprite.velocity.y = -std::abs(sprite.velocity.y); }
+      sprite.draw.rotation += sprite.spin * seconds;
+      spriteBatch.submit(sprite.draw);
+    }
+  }
+
+  GameState &                          gs;
+  ThreadPool &                         pool;
+  AssetManager &                       assets;
+  sf::Vector2f                         view;
+  std::optional<std::filesystem::path> latencyLog;
+  AssetManager::clock::time_point      started;
+
+  std::array<bool, steps.size()>        states{};
+  std::array<std::string, steps.size()> stepLabels;
+  bool                                  joystickEvent{ false };
+  bool                                  closing{ false };
+
+  std::uint64_t      eventsProcessed{ 0 };
+  std::vector<Event> events{ GameState::TimeElapsed{} };
+
+  std::unique_ptr<NetplaySession> netplay;
+  std::vector<Event>              netplayInputs;
+
+  TextureAtlas              atlas;
+  SpriteBatch               spriteBatch{ atlas };
+  std::vector<StressSprite> stressSprites;
+
+  std::optional<AssetManager::clock::duration> firstFrame;
+
+#ifdef GAME_TRACK_ALLOCATIONS
+  Allocations::Counters lastFrameAllocations;
+  // naming sites allocates, so the list is only refreshed on request
+  std::vector<std::pair<Allocations::Site, std::string>> allocationSites;
+#endif
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_GAMELOOP_HPP
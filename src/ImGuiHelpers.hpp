@@ -6,13 +6,17 @@
 #define MYPROJECT_IMGUIHELPERS_HPP
 
 #include <imgui.h>
+#include <iterator>
 #include <string_view>
 #include <fmt/format.h>
 
 namespace ImGuiHelper {
+// formats into a stack buffer so per frame text does not hit the heap
 template<typename... Param> static void Text(std::string_view format, Param && ... param)
 {
-  ImGui::TextUnformatted(fmt::format(format, std::forward<Param>(param)...).c_str());
+  fmt::memory_buffer buffer;
+  fmt::format_to(std::back_inserter(buffer), format, std::forward<Param>(param)...);
+  ImGui::TextUnformatted(buffer.data(), buffer.data() + buffer.size());
 }
 
 }
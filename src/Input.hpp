@@ -5,6 +5,7 @@
 #ifndef MYPROJECT_INPUT_HPP
 #define MYPROJECT_INPUT_HPP
 
+#include <SFML/Graphics/RenderWindow.hpp>
 #include <SFML/System/Time.hpp>
 #include <SFML/Window/Event.hpp>
 #include <SFML/Window/Joystick.hpp>
@@ -13,8 +14,12 @@
 #include <chrono>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <variant>
 
+#include "ECS.hpp"
+#include "Latency.hpp"
+#include "Simulation.hpp"
 #include "Utility.hpp"
 
 namespace Game {
@@ -48,11 +53,15 @@ struct GameState
   using clock = std::chrono::steady_clock;
   clock::time_point lastTick{ clock::now() };
 
+  // Events compare memberwise so a rollback session can check a peer's late
+  // input against what it predicted; see Rollback.hpp.
   template<typename Source> struct Pressed
   {
     constexpr static std::string_view name{ "Pressed" };
     constexpr static std::array       elements{ std::string_view{ "source" } };
     Source                            source;
+
+    [[nodiscard]] constexpr bool operator==(const Pressed &) const = default;
   };
 
   template<typename Source> struct Released
@@ -60,6 +69,8 @@ struct GameState
     constexpr static std::string_view name{ "Released" };
     constexpr static std::array       elements{ std::string_view{ "source" } };
     Source                            source;
+
+    [[nodiscard]] constexpr bool operator==(const Released &) const = default;
   };
 
   template<typename Source> struct Moved
@@ -67,6 +78,8 @@ struct GameState
     constexpr static std::string_view name{ "Moved" };
     constexpr static std::array       elements{ std::string_view{ "source" } };
     Source                            source;
+
+    [[nodiscard]] constexpr bool operator==(const Moved &) const = default;
   };
 
   struct JoystickButton
@@ -75,6 +88,8 @@ struct GameState
     constexpr static auto             elements = std::to_array<std::string_view>({ "id", "button" });
     unsigned int                      id;
     unsigned int                      button;
+
+    [[nodiscard]] constexpr bool operator==(const JoystickButton &) const = default;
   };
 
   struct JoystickAxis
@@ -84,6 +99,8 @@ struct GameState
     unsigned int                      id;
     unsigned int                      axis;
     float                             position;
+
+    [[nodiscard]] constexpr bool operator==(const JoystickAxis &) const = default;
   };
 
   struct Mouse
@@ -92,6 +109,8 @@ struct GameState
     constexpr static auto             elements = std::to_array<std::string_view>({ "x", "y" });
     int                               x;
     int                               y;
+
+    [[nodiscard]] constexpr bool operator==(const Mouse &) const = default;
   };
 
   struct MouseButton
@@ -100,6 +119,8 @@ struct GameState
     constexpr static auto             elements = std::to_array<std::string_view>({ "button", "mouse" });
     int                               button;
     Mouse                             mouse;
+
+    [[nodiscard]] constexpr bool operator==(const MouseButton &) const = default;
   };
 
   struct Key
@@ -111,12 +132,16 @@ struct GameState
     bool                  system;
     bool                  shift;
     sf::Keyboard::Key     key;
+
+    [[nodiscard]] constexpr bool operator==(const Key &) const = default;
   };
 
   struct CloseWindow
   {
     constexpr static std::string_view                name{ "CloseWindow" };
     constexpr static std::array<std::string_view, 0> elements{};
+
+    [[nodiscard]] constexpr bool operator==(const CloseWindow &) const = default;
   };
 
   struct TimeElapsed
@@ -125,6 +150,8 @@ struct GameState
     constexpr static auto             elements = std::to_array<std::string_view>({ "elapsed" });
     clock::duration                   elapsed;
 
+    [[nodiscard]] constexpr bool operator==(const TimeElapsed &) const = default;
+
     [[nodiscard]] sf::Time toSFMLTime() const
     {
       return sf::microseconds(duration_cast<std::chrono::microseconds>(elapsed).count());
@@ -160,6 +187,17 @@ struct GameState
 
   std::vector<Joystick> joySticks;
 
+  // everything netplay snapshots and rolls back; see Simulation.hpp
+  Simulation     simulation;
+  ECS::Scheduler systems;
+
+  // one simulation tick
+  void step(ThreadPool &pool) { simulation.step(systems, pool); }
+
+  void update(const Moved<Mouse> &mouse) { simulation.hover(mouse.source.x, mouse.source.y); }
+
+  void update(const Pressed<MouseButton> &button) { simulation.select(button.source.mouse.x, button.source.mouse.y); }
+
   static void refreshJoystick(Joystick &js)
   {
     sf::Joystick::update();
@@ -285,13 +323,39 @@ struct GameState
       event);
   }
 
+  static std::optional<InputSource> inputSource(const Event &event)
+  {
+    return std::visit(
+      overloaded{ [](const Pressed<Key> &) -> std::optional<InputSource> { return InputSource::Key; },
+                  [](const Released<Key> &) -> std::optional<InputSource> { return InputSource::Key; },
+                  [](const Moved<Mouse> &) -> std::optional<InputSource> { return InputSource::Mouse; },
+                  [](const Pressed<MouseButton> &) -> std::optional<InputSource> { return InputSource::Mouse; },
+                  [](const Released<MouseButton> &) -> std::optional<InputSource> { return InputSource::Mouse; },
+                  [](const Pressed<JoystickButton> &) -> std::optional<InputSource> { return InputSource::Joystick; },
+                  [](const Released<JoystickButton> &) -> std::optional<InputSource> { return InputSource::Joystick; },
+                  [](const Moved<JoystickAxis> &) -> std::optional<InputSource> { return InputSource::Joystick; },
+                  [](const auto &) -> std::optional<InputSource> { return {}; } },
+      event);
+  }
+
+  LatencyTracker latency;
+
+  // stamp input events as they are polled, the stamps are resolved on latency.presented()
+  Event stampInput(Event event)
+  {
+    if (const auto source = inputSource(event); source) { latency.polled(*source); }
+    return event;
+  }
+
   std::vector<Event> pendingEvents;
 
   void setEvents(std::vector<Event> events) {
     pendingEvents = std::move(events);
   }
 
-  Event nextEvent(sf::RenderWindow &window)
+  // Window is normally an sf::RenderWindow; anything with pollEvent(sf::Event &)
+  // works, which lets tests replay events without opening a window.
+  template<typename Window> Event nextEvent(Window &window)
   {
     if (!pendingEvents.empty()) {
       auto event = pendingEvents.front();
@@ -302,16 +366,18 @@ struct GameState
                      std::this_thread::sleep_for(te.elapsed);
                    },
                    [&](const Moved<Mouse> &me) {
-                     sf::Mouse::setPosition({me.source.x, me.source.y}, window);
+                     if constexpr (std::is_base_of_v<sf::Window, Window>) {
+                       sf::Mouse::setPosition({ me.source.x, me.source.y }, window);
+                     }
                    },
                    [](const auto &) { }
                  },
                  event);
-      return event;
+      return stampInput(event);
     }
 
     sf::Event event{};
-    if (window.pollEvent(event)) { return toEvent(event); }
+    if (window.pollEvent(event)) { return stampInput(toEvent(event)); }
 
     const auto nextTick    = clock::now();
     const auto timeElapsed = nextTick - lastTick;
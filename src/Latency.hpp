@@ -0,0 +1,168 @@
+#ifndef MYPROJECT_LATENCY_HPP
+#define MYPROJECT_LATENCY_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ostream>
+#include <string_view>
+
+namespace Game {
+
+enum class InputSource { Key, Mouse, Joystick };
+
+constexpr std::string_view toString(const InputSource source)
+{
+  switch (source) {
+  case InputSource::Key:
+    return "Key";
+  case InputSource::Mouse:
+    return "Mouse";
+  case InputSource::Joystick:
+    return "Joystick";
+  }
+  abort();
+}
+
+// log-linear histogram of microsecond values, 16 sub buckets per power of two
+// so the reported percentiles are within ~6% of the real value
+struct LatencyHistogram
+{
+  static constexpr std::uint64_t SubBucketBits  = 4;
+  static constexpr std::uint64_t SubBucketCount = 1 << SubBucketBits;
+  static constexpr std::uint64_t MaxValue       = 0xFFFFFFFF;
+  static constexpr std::size_t   BucketCount    = (32 - SubBucketBits + 1) * SubBucketCount;
+
+  std::array<std::uint32_t, BucketCount> buckets{};
+  std::uint64_t                          count{ 0 };
+  std::uint64_t                          max{ 0 };
+
+  [[nodiscard]] static constexpr std::size_t bucketIndex(std::uint64_t value)
+  {
+    value = std::min(value, MaxValue);
+    if (value < SubBucketCount) { return value; }
+
+    const auto msb   = static_cast<unsigned int>(std::bit_width(value)) - 1U;
+    const auto shift = msb - SubBucketBits;
+    return (shift + 1) * SubBucketCount + ((value >> shift) & (SubBucketCount - 1));
+  }
+
+  // largest value that lands in the given bucket
+  [[nodiscard]] static constexpr std::uint64_t bucketValue(const std::size_t index)
+  {
+    if (index < SubBucketCount) { return index; }
+
+    const auto shift = index / SubBucketCount - 1;
+    const auto sub   = index % SubBucketCount;
+    return ((SubBucketCount + sub) << shift) + (std::uint64_t{ 1 } << shift) - 1;
+  }
+
+  constexpr void record(const std::uint64_t value)
+  {
+    ++buckets[bucketIndex(value)];
+    ++count;
+    max = std::max(max, value);
+  }
+
+  [[nodiscard]] constexpr std::uint64_t percentile(const double fraction) const
+  {
+    if (count == 0) { return 0; }
+
+    const auto target = static_cast<std::uint64_t>(static_cast<double>(count) * fraction + 0.5);
+    std::uint64_t seen = 0;
+    for (std::size_t index = 0; index < buckets.size(); ++index) {
+      seen += buckets[index];
+      if (seen >= std::max(target, std::uint64_t{ 1 })) { return std::min(bucketValue(index), max); }
+    }
+    return max;
+  }
+};
+
+// Tracks the time from an input event being polled to the frame that first
+// presents its effect. Stamps live in a fixed buffer, nothing allocates.
+struct LatencyTracker
+{
+  using clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t MaxPending = 256;
+
+  struct Stamp
+  {
+    InputSource       source;
+    clock::time_point polled;
+  };
+
+  std::array<Stamp, MaxPending>   pending{};
+  std::size_t                     pendingCount{ 0 };
+  std::uint64_t                   dropped{ 0 };
+  std::uint64_t                   frames{ 0 };
+  std::array<LatencyHistogram, 3> histograms{};
+
+  void polled(const InputSource source, const clock::time_point time = clock::now())
+  {
+    if (pendingCount == pending.size()) [[unlikely]] {
+      ++dropped;
+      return;
+    }
+    pending[pendingCount++] = Stamp{ source, time };
+  }
+
+  // call right after window.display()
+  void presented(const clock::time_point time = clock::now())
+  {
+    ++frames;
+    for (std::size_t index = 0; index < pendingCount; ++index) {
+      const auto &stamp   = pending[index];
+      const auto  elapsed = std::chrono::duration_cast<std::chrono::microseconds>(time - stamp.polled).count();
+      histogram(stamp.source).record(static_cast<std::uint64_t>(std::max(elapsed, decltype(elapsed){ 0 })));
+    }
+    pendingCount = 0;
+  }
+
+  [[nodiscard]] LatencyHistogram &histogram(const InputSource source)
+  {
+    return histograms[static_cast<std::size_t>(source)];
+  }
+
+  [[nodiscard]] const LatencyHistogram &histogram(const InputSource source) const
+  {
+    return histograms[static_cast<std::size_t>(source)];
+  }
+
+  void reset()
+  {
+    histograms   = {};
+    pendingCount = 0;
+    dropped      = 0;
+    frames       = 0;
+  }
+
+  void dump(std::ostream &os) const
+  {
+    os << "# input latency, microseconds from poll to present\n";
+    os << "# frames " << frames << " dropped " << dropped << '\n';
+    os << "source,count,p50,p95,p99,max\n";
+    for (const auto source : { InputSource::Key, InputSource::Mouse, InputSource::Joystick }) {
+      const auto &h = histogram(source);
+      os << toString(source) << ',' << h.count << ',' << h.percentile(0.50) << ',' << h.percentile(0.95) << ','
+         << h.percentile(0.99) << ',' << h.max << '\n';
+    }
+
+    os << "\nsource,bucket_max,count\n";
+    for (const auto source : { InputSource::Key, InputSource::Mouse, InputSource::Joystick }) {
+      const auto &h = histogram(source);
+      for (std::size_t index = 0; index < h.buckets.size(); ++index) {
+        if (h.buckets[index] != 0) {
+          os << toString(source) << ',' << LatencyHistogram::bucketValue(index) << ',' << h.buckets[index] << '\n';
+        }
+      }
+    }
+  }
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_LATENCY_HPP
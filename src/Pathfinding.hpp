@@ -0,0 +1,936 @@
+#ifndef MYPROJECT_PATHFINDING_HPP
+#define MYPROJECT_PATHFINDING_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace Game {
+
+struct GridPoint
+{
+  int x{ 0 };
+  int y{ 0 };
+
+  [[nodiscard]] constexpr bool operator==(const GridPoint &) const = default;
+};
+
+// half open rectangle of tiles
+struct GridRect
+{
+  int minX{ 0 };
+  int minY{ 0 };
+  int maxX{ 0 };
+  int maxY{ 0 };
+
+  [[nodiscard]] constexpr bool contains(const GridPoint point) const noexcept
+  {
+    return point.x >= minX && point.x < maxX && point.y >= minY && point.y < maxY;
+  }
+
+  [[nodiscard]] constexpr int         width() const noexcept { return maxX - minX; }
+  [[nodiscard]] constexpr int         height() const noexcept { return maxY - minY; }
+  [[nodiscard]] constexpr std::size_t area() const noexcept
+  {
+    return static_cast<std::size_t>(width()) * static_cast<std::size_t>(height());
+  }
+};
+
+[[nodiscard]] inline std::uint32_t manhattan(const GridPoint lhs, const GridPoint rhs) noexcept
+{
+  return static_cast<std::uint32_t>(std::abs(lhs.x - rhs.x) + std::abs(lhs.y - rhs.y));
+}
+
+// Movement cost of every tile, stored row major. Stepping onto a tile costs
+// its value; Blocked tiles can not be entered.
+class TileGrid
+{
+public:
+  static constexpr std::uint8_t Blocked = 0;
+
+  TileGrid(const int width, const int height, const std::uint8_t cost = 1)
+    : columns{ width }, rows{ height }, tiles(checkedArea(width, height), cost)
+  {}
+
+  [[nodiscard]] int      width() const noexcept { return columns; }
+  [[nodiscard]] int      height() const noexcept { return rows; }
+  [[nodiscard]] GridRect bounds() const noexcept { return { 0, 0, columns, rows }; }
+
+  [[nodiscard]] bool contains(const GridPoint point) const noexcept { return bounds().contains(point); }
+
+  [[nodiscard]] std::uint8_t cost(const GridPoint point) const noexcept { return tiles[index(point)]; }
+  [[nodiscard]] bool         passable(const GridPoint point) const noexcept { return cost(point) != Blocked; }
+
+  void setCost(const GridPoint point, const std::uint8_t cost)
+  {
+    if (!contains(point)) { throw std::out_of_range("tile is outside of the grid"); }
+    tiles[index(point)] = cost;
+  }
+
+private:
+  static std::size_t checkedArea(const int width, const int height)
+  {
+    if (width <= 0 || height <= 0) { throw std::invalid_argument("grid must not be empty"); }
+    return GridRect{ 0, 0, width, height }.area();
+  }
+
+  [[nodiscard]] std::size_t index(const GridPoint point) const noexcept
+  {
+    return static_cast<std::size_t>(point.y) * static_cast<std::size_t>(columns) + static_cast<std::size_t>(point.x);
+  }
+
+  int                       columns;
+  int                       rows;
+  std::vector<std::uint8_t> tiles;
+};
+
+namespace detail {
+  // Open set for any integer priorities, ties go to the entry closer to the goal.
+  class HeapQueue
+  {
+  public:
+    void clear() noexcept { heap.clear(); }
+
+    void push(const std::uint32_t priority, const std::uint32_t cost, const std::uint32_t node)
+    {
+      heap.push_back({ priority, cost, node });
+      std::push_heap(heap.begin(), heap.end(), later);
+    }
+
+    std::optional<std::uint32_t> pop()
+    {
+      if (heap.empty()) { return {}; }
+      std::pop_heap(heap.begin(), heap.end(), later);
+      const auto node = heap.back().node;
+      heap.pop_back();
+      return node;
+    }
+
+  private:
+    struct Entry
+    {
+      std::uint32_t priority;
+      std::uint32_t cost;
+      std::uint32_t node;
+    };
+
+    static bool later(const Entry &lhs, const Entry &rhs) noexcept
+    {
+      return lhs.priority > rhs.priority || (lhs.priority == rhs.priority && lhs.cost < rhs.cost);
+    }
+
+    std::vector<Entry> heap;
+  };
+
+  // Open set for priorities that never drop below the last one popped and never
+  // grow by Span or more at once, which holds for tile steps costing at most 255
+  // under a Manhattan estimate. Push and pop are constant time.
+  class BucketQueue
+  {
+  public:
+    static constexpr std::uint32_t Span = 512;
+
+    void clear() noexcept
+    {
+      if (count != 0) {
+        for (auto &bucket : buckets) { bucket.clear(); }
+      }
+      count = 0;
+    }
+
+    void push(const std::uint32_t priority, const std::uint32_t /*cost*/, const std::uint32_t node)
+    {
+      if (count == 0 || priority < current) { current = priority; }
+      buckets[priority % Span].push_back(node);
+      ++count;
+    }
+
+    std::optional<std::uint32_t> pop()
+    {
+      if (count == 0) { return {}; }
+      while (buckets[current % Span].empty()) { ++current; }
+
+      // last in first out, among equal priorities the deeper node
+      auto &     bucket = buckets[current % Span];
+      const auto node   = bucket.back();
+      bucket.pop_back();
+      --count;
+      return node;
+    }
+
+  private:
+    std::array<std::vector<std::uint32_t>, Span> buckets;
+    std::uint32_t                                current{ 0 };
+    std::size_t                                  count{ 0 };
+  };
+
+  // Open and closed sets of a best first search over dense node ids. Nodes are
+  // stamped with a generation that advances every search, so nothing has to be
+  // cleared between queries and the buffers only ever grow.
+  template<typename Queue> class SearchState
+  {
+  public:
+    void begin(const std::size_t size)
+    {
+      if (stamps.size() < size) {
+        stamps.resize(size, 0);
+        costs.resize(size);
+        parents.resize(size);
+      }
+
+      generation += 2;
+      if (generation >= std::numeric_limits<std::uint32_t>::max() - 2) {
+        std::fill(stamps.begin(), stamps.end(), 0);
+        generation = 2;
+      }
+      open.clear();
+    }
+
+    [[nodiscard]] bool closed(const std::uint32_t node) const noexcept { return stamps[node] == generation + 1; }
+    [[nodiscard]] std::uint32_t cost(const std::uint32_t node) const noexcept { return costs[node]; }
+    [[nodiscard]] std::uint32_t parent(const std::uint32_t node) const noexcept { return parents[node]; }
+
+    // whether relax would open node, checked first when the estimate is not free
+    [[nodiscard]] bool improves(const std::uint32_t node, const std::uint32_t cost) const noexcept
+    {
+      return !closed(node) && (stamps[node] != generation || cost < costs[node]);
+    }
+
+    // opens node through parent unless it is already known at a lower cost
+    void relax(const std::uint32_t node,
+      const std::uint32_t          parent,
+      const std::uint32_t          cost,
+      const std::uint32_t          estimate)
+    {
+      if (!improves(node, cost)) { return; }
+      stamps[node]  = generation;
+      costs[node]   = cost;
+      parents[node] = parent;
+      open.push(cost + estimate, cost, node);
+    }
+
+    // closes and returns the open node with the lowest estimate
+    std::optional<std::uint32_t> pop()
+    {
+      // a node is pushed again for every improvement, only its best entry counts
+      while (const auto node = open.pop()) {
+        if (!closed(*node)) {
+          stamps[*node] = generation + 1;
+          return node;
+        }
+      }
+      return {};
+    }
+
+  private:
+    std::vector<std::uint32_t> stamps;
+    std::vector<std::uint32_t> costs;
+    std::vector<std::uint32_t> parents;
+    Queue                      open;
+    std::uint32_t              generation{ 0 };
+  };
+}// namespace detail
+
+// A* and Dijkstra over the 4-connected tiles of a rectangle. Tiles are indexed
+// relative to the rectangle, so searches bounded to a cluster touch only a few
+// kilobytes of scratch. Reuse one GridSearch per thread.
+class GridSearch
+{
+public:
+  static constexpr std::uint32_t Unreachable = std::numeric_limits<std::uint32_t>::max();
+
+  // appends start..goal to path, returns false if goal can not be reached inside bounds
+  bool findPath(const TileGrid &grid,
+    const GridPoint             start,
+    const GridPoint             goal,
+    const GridRect &            bounds,
+    std::vector<GridPoint> &    path)
+  {
+    if (!run(grid, start, goal, bounds)) { return false; }
+
+    const auto first = path.size();
+    for (auto node = localIndex(goal);; node = state.parent(node)) {
+      path.push_back(pointOf(node));
+      if (node == state.parent(node)) { break; }
+    }
+    std::reverse(path.begin() + static_cast<std::ptrdiff_t>(first), path.end());
+    return true;
+  }
+
+  // Distances from start to the tiles inside bounds, read them with distance().
+  // With targets the search may stop as soon as all of them are known.
+  void expand(const TileGrid &grid,
+    const GridPoint           start,
+    const GridRect &          bounds,
+    std::span<const GridPoint> targets = {})
+  {
+    region = bounds;
+    if (targetFlags.size() < bounds.area()) { targetFlags.resize(bounds.area(), 0); }
+
+    remainingTargets = 0;
+    for (const auto &target : targets) {
+      if (!bounds.contains(target)) { continue; }
+      auto &flag = targetFlags[localIndex(target)];
+      if (flag == 0) { ++remainingTargets; }
+      flag = 1;
+    }
+
+    run(grid, start, std::nullopt, bounds);
+
+    for (const auto &target : targets) {
+      if (bounds.contains(target)) { targetFlags[localIndex(target)] = 0; }
+    }
+    remainingTargets = 0;
+  }
+
+  // cost of the cheapest path found by the last search, Unreachable if there is none
+  [[nodiscard]] std::uint32_t distance(const GridPoint point) const noexcept
+  {
+    if (!region.contains(point)) { return Unreachable; }
+    const auto node = localIndex(point);
+    return state.closed(node) ? state.cost(node) : Unreachable;
+  }
+
+private:
+  static constexpr std::array<GridPoint, 4> Steps{ { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } } };
+
+  bool run(const TileGrid &grid, const GridPoint start, const std::optional<GridPoint> goal, const GridRect &bounds)
+  {
+    region = bounds;
+    state.begin(bounds.area());
+
+    if (!bounds.contains(start) || !grid.passable(start)) { return false; }
+    if (goal && (!bounds.contains(*goal) || !grid.passable(*goal))) { return false; }
+
+    const auto estimate = [&goal](const GridPoint point) { return goal ? manhattan(point, *goal) : 0U; };
+
+    state.relax(localIndex(start), localIndex(start), 0, estimate(start));
+    while (const auto node = state.pop()) {
+      const auto point = pointOf(*node);
+      if (goal && point == *goal) { return true; }
+      if (remainingTargets != 0 && targetFlags[*node] != 0 && --remainingTargets == 0) { break; }
+
+      const auto cost = state.cost(*node);
+      for (const auto &step : Steps) {
+        const GridPoint next{ point.x + step.x, point.y + step.y };
+        if (!bounds.contains(next)) { continue; }
+        if (const auto tile = grid.cost(next); tile != TileGrid::Blocked) {
+          state.relax(localIndex(next), *node, cost + tile, estimate(next));
+        }
+      }
+    }
+
+    return !goal;
+  }
+
+  [[nodiscard]] std::uint32_t localIndex(const GridPoint point) const noexcept
+  {
+    return static_cast<std::uint32_t>((point.y - region.minY) * region.width() + (point.x - region.minX));
+  }
+
+  [[nodiscard]] GridPoint pointOf(const std::uint32_t node) const noexcept
+  {
+    const auto width = static_cast<std::uint32_t>(region.width());
+    return { region.minX + static_cast<int>(node % width), region.minY + static_cast<int>(node / width) };
+  }
+
+  detail::SearchState<detail::BucketQueue> state;
+  GridRect                                 region;
+  std::vector<std::uint8_t>                targetFlags;// by local index, only set during expand
+  std::size_t                              remainingTargets{ 0 };
+};
+
+// Hierarchical pathfinding over a TileGrid with a shared path cache.
+//
+// The grid is cut into square clusters. Every run of open tiles along a
+// cluster border gets one or two transitions, and the cost between the
+// transitions of a cluster is precomputed. A query searches that small graph
+// and then refines each hop with a search bounded to one cluster. Paths are
+// close to, but not always, the cheapest.
+//
+// Changing a tile only rebuilds the clusters that touch it. A more expensive
+// tile only drops the cached paths that run through it; a cheaper one drops
+// the whole cache, since the detour it saves can lie anywhere on the map.
+// Queries without a path are cached as well.
+class PathService
+{
+public:
+  using Path       = std::vector<GridPoint>;
+  using PathHandle = std::shared_ptr<const Path>;// null when there is no path
+
+  struct Request
+  {
+    GridPoint start;
+    GridPoint goal;
+  };
+
+  struct Stats
+  {
+    std::uint64_t hits{ 0 };
+    std::uint64_t misses{ 0 };
+    std::uint64_t invalidated{ 0 };
+    std::uint64_t clustersRebuilt{ 0 };
+  };
+
+  explicit PathService(TileGrid map, const int clusterSize = 32, const std::size_t cacheCapacity = 65536)
+    : tiles{ std::move(map) }, clusterExtent{ clusterSize }, capacity{ cacheCapacity }
+  {
+    if (clusterSize < 2) { throw std::invalid_argument("cluster size must be at least 2"); }
+
+    clusterColumns = (tiles.width() + clusterExtent - 1) / clusterExtent;
+    clusterRows    = (tiles.height() + clusterExtent - 1) / clusterExtent;
+    clusters.resize(static_cast<std::size_t>(clusterColumns) * static_cast<std::size_t>(clusterRows));
+    clusterPaths.resize(clusters.size());
+
+    for (int row = 0; row < clusterRows; ++row) {
+      for (int column = 0; column < clusterColumns; ++column) {
+        clusters[clusterIndex(column, row)].bounds = GridRect{ column * clusterExtent,
+          row * clusterExtent,
+          std::min((column + 1) * clusterExtent, tiles.width()),
+          std::min((row + 1) * clusterExtent, tiles.height()) };
+        dirty.push_back(clusterIndex(column, row));
+      }
+    }
+  }
+
+  [[nodiscard]] const TileGrid &grid() const noexcept { return tiles; }
+  [[nodiscard]] const Stats &   stats() const noexcept { return statistics; }
+  [[nodiscard]] std::size_t     cachedPaths() const noexcept { return cache.size(); }
+  [[nodiscard]] std::size_t     clusterCount() const noexcept { return clusters.size(); }
+  [[nodiscard]] std::size_t     nodeCount() const noexcept { return nodeClusters.size(); }
+
+  void setCost(const GridPoint point, const std::uint8_t cost)
+  {
+    if (!tiles.contains(point)) { throw std::out_of_range("tile is outside of the grid"); }
+
+    const auto previous = tiles.cost(point);
+    tiles.setCost(point, cost);
+    if (previous == cost) { return; }
+
+    const auto column  = point.x / clusterExtent;
+    const auto row     = point.y / clusterExtent;
+    const auto bounds  = clusters[clusterIndex(column, row)].bounds;
+    const bool cheaper = previous == TileGrid::Blocked || (cost != TileGrid::Blocked && cost < previous);
+
+    // A more expensive tile only matters to the paths crossing it. A cheaper
+    // one can shorten or open paths that never came near it, opening a gap in
+    // a wall shortens every detour around that wall.
+    if (cheaper) {
+      invalidateAll();
+    } else {
+      invalidate(clusterIndex(column, row), point);
+    }
+
+    // the neighbour shares transitions only with tiles on the border
+    markDirty(column, row);
+    if (point.x == bounds.minX && column > 0) { markDirty(column - 1, row); }
+    if (point.x == bounds.maxX - 1 && column + 1 < clusterColumns) { markDirty(column + 1, row); }
+    if (point.y == bounds.minY && row > 0) { markDirty(column, row - 1); }
+    if (point.y == bounds.maxY - 1 && row + 1 < clusterRows) { markDirty(column, row + 1); }
+  }
+
+  // rebuilds the clusters changed since the last query, which otherwise happens lazily
+  void prepare(ThreadPool *pool = nullptr)
+  {
+    if (dirty.empty()) { return; }
+
+    const auto rebuild = [this](const std::size_t begin, const std::size_t end) {
+      WorkspaceLease workspace{ *this };
+      for (auto index = begin; index < end; ++index) { rebuildCluster(clusters[dirty[index]], workspace->search); }
+    };
+
+    if (pool != nullptr) {
+      pool->parallelFor(dirty.size(), 16, rebuild);
+    } else {
+      rebuild(0, dirty.size());
+    }
+
+    // links into a rebuilt cluster are resolved again from both sides
+    for (const auto index : dirty) {
+      const auto column = static_cast<int>(index % static_cast<std::size_t>(clusterColumns));
+      const auto row    = static_cast<int>(index / static_cast<std::size_t>(clusterColumns));
+      resolveLinks(clusters[index]);
+      if (column > 0) { resolveLinks(clusters[clusterIndex(column - 1, row)]); }
+      if (column + 1 < clusterColumns) { resolveLinks(clusters[clusterIndex(column + 1, row)]); }
+      if (row > 0) { resolveLinks(clusters[clusterIndex(column, row - 1)]); }
+      if (row + 1 < clusterRows) { resolveLinks(clusters[clusterIndex(column, row + 1)]); }
+    }
+
+    statistics.clustersRebuilt += dirty.size();
+    for (const auto index : dirty) { clusters[index].dirty = false; }
+    dirty.clear();
+
+    nodeOffsets.clear();
+    nodeClusters.clear();
+    nodePoints.clear();
+    for (std::size_t index = 0; index < clusters.size(); ++index) {
+      nodeOffsets.push_back(static_cast<std::uint32_t>(nodeClusters.size()));
+      nodeClusters.insert(nodeClusters.end(), clusters[index].nodes.size(), static_cast<std::uint32_t>(index));
+      nodePoints.insert(nodePoints.end(), clusters[index].nodes.begin(), clusters[index].nodes.end());
+    }
+  }
+
+  PathHandle find(const GridPoint start, const GridPoint goal)
+  {
+    prepare();
+
+    const auto key = cacheKey(start, goal);
+    if (!key) { return {}; }
+    if (auto cached = lookup(*key); cached) { return *cached; }
+
+    WorkspaceLease workspace{ *this };
+    auto           path = compute(start, goal, *workspace);
+    store(*key, path);
+    return path;
+  }
+
+  // Answers every request, computing the cache misses on the pool. Requests
+  // that share a start and goal are only computed once.
+  void findBatch(std::span<const Request> requests, std::span<PathHandle> results, ThreadPool &pool)
+  {
+    if (requests.size() != results.size()) { throw std::invalid_argument("one result is needed per request"); }
+
+    prepare(&pool);
+
+    constexpr auto NoMiss = std::numeric_limits<std::size_t>::max();
+
+    batchMisses.clear();
+    batchOwners.assign(requests.size(), NoMiss);
+    batchPending.clear();
+
+    for (std::size_t index = 0; index < requests.size(); ++index) {
+      results[index] = nullptr;
+
+      const auto key = cacheKey(requests[index].start, requests[index].goal);
+      if (!key) { continue; }
+
+      if (const auto pending = batchPending.find(*key); pending != batchPending.end()) {
+        batchOwners[index] = pending->second;
+      } else if (auto cached = lookup(*key); cached) {
+        results[index] = std::move(*cached);
+      } else {
+        batchOwners[index] = batchMisses.size();
+        batchPending.emplace(*key, batchMisses.size());
+        batchMisses.push_back(index);
+      }
+    }
+
+    batchPaths.assign(batchMisses.size(), nullptr);
+    pool.parallelFor(batchMisses.size(), 8, [&](const std::size_t begin, const std::size_t end) {
+      WorkspaceLease workspace{ *this };
+      for (auto miss = begin; miss < end; ++miss) {
+        const auto &request = requests[batchMisses[miss]];
+        batchPaths[miss]    = compute(request.start, request.goal, *workspace);
+      }
+    });
+
+    for (std::size_t miss = 0; miss < batchMisses.size(); ++miss) {
+      const auto &request = requests[batchMisses[miss]];
+      store(*cacheKey(request.start, request.goal), batchPaths[miss]);
+    }
+
+    for (std::size_t index = 0; index < requests.size(); ++index) {
+      if (batchOwners[index] != NoMiss) { results[index] = batchPaths[batchOwners[index]]; }
+    }
+  }
+
+  void clearCache()
+  {
+    cache.clear();
+    for (auto &keys : clusterPaths) { keys.clear(); }
+  }
+
+private:
+  // entrances wider than this get a transition at both ends instead of one in the middle
+  static constexpr int LongEntrance = 6;
+
+  // a transition tile and its counterpart across the border
+  struct Link
+  {
+    std::uint32_t node;
+    GridPoint     across;
+    std::uint32_t targetCluster;
+    std::uint32_t targetNode;
+  };
+
+  struct Cluster
+  {
+    GridRect                   bounds;
+    std::vector<GridPoint>     nodes;// transition tiles inside this cluster
+    std::vector<Link>          links;// sorted by node
+    std::vector<std::uint32_t> firstLink;// links of node n are [firstLink[n], firstLink[n + 1])
+    std::vector<std::uint32_t> distances;// nodes x nodes, staying inside the cluster
+    bool                       dirty{ true };
+  };
+
+  // scratch of one query, handed out per thread
+  struct Workspace
+  {
+    GridSearch                                           search;
+    detail::SearchState<detail::HeapQueue>               route;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> startEdges;// node, cost from the start
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> goalEdges;// node, cost to the goal
+    std::vector<GridPoint>                               waypoints;
+  };
+
+  class WorkspaceLease
+  {
+  public:
+    explicit WorkspaceLease(PathService &owner) : service{ owner }
+    {
+      std::scoped_lock lock(service.workspaceMutex);
+      if (service.workspaces.empty()) {
+        workspace = std::make_unique<Workspace>();
+      } else {
+        workspace = std::move(service.workspaces.back());
+        service.workspaces.pop_back();
+      }
+    }
+
+    WorkspaceLease(const WorkspaceLease &) = delete;
+    WorkspaceLease(WorkspaceLease &&)      = delete;
+    WorkspaceLease &operator=(const WorkspaceLease &) = delete;
+    WorkspaceLease &operator=(WorkspaceLease &&) = delete;
+
+    ~WorkspaceLease()
+    {
+      std::scoped_lock lock(service.workspaceMutex);
+      service.workspaces.push_back(std::move(workspace));
+    }
+
+    Workspace &operator*() const noexcept { return *workspace; }
+    Workspace *operator->() const noexcept { return workspace.get(); }
+
+  private:
+    PathService &              service;
+    std::unique_ptr<Workspace> workspace;
+  };
+
+  [[nodiscard]] std::size_t clusterIndex(const int column, const int row) const noexcept
+  {
+    return static_cast<std::size_t>(row) * static_cast<std::size_t>(clusterColumns) + static_cast<std::size_t>(column);
+  }
+
+  [[nodiscard]] std::size_t clusterOf(const GridPoint point) const noexcept
+  {
+    return clusterIndex(point.x / clusterExtent, point.y / clusterExtent);
+  }
+
+  [[nodiscard]] std::optional<std::uint64_t> cacheKey(const GridPoint start, const GridPoint goal) const noexcept
+  {
+    if (!tiles.contains(start) || !tiles.contains(goal)) { return {}; }
+    const auto index = [this](const GridPoint point) {
+      return static_cast<std::uint64_t>(point.y) * static_cast<std::uint64_t>(tiles.width())
+             + static_cast<std::uint64_t>(point.x);
+    };
+    return (index(start) << 32U) | index(goal);
+  }
+
+  void markDirty(const int column, const int row)
+  {
+    auto &cluster = clusters[clusterIndex(column, row)];
+    if (!cluster.dirty) {
+      cluster.dirty = true;
+      dirty.push_back(clusterIndex(column, row));
+    }
+  }
+
+  void rebuildCluster(Cluster &cluster, GridSearch &search) const
+  {
+    cluster.nodes.clear();
+    cluster.links.clear();
+
+    const auto &bounds = cluster.bounds;
+    if (bounds.minX > 0) { scanBorder(cluster, { bounds.minX, bounds.minY }, { 0, 1 }, { -1, 0 }, bounds.height()); }
+    if (bounds.maxX < tiles.width()) {
+      scanBorder(cluster, { bounds.maxX - 1, bounds.minY }, { 0, 1 }, { 1, 0 }, bounds.height());
+    }
+    if (bounds.minY > 0) { scanBorder(cluster, { bounds.minX, bounds.minY }, { 1, 0 }, { 0, -1 }, bounds.width()); }
+    if (bounds.maxY < tiles.height()) {
+      scanBorder(cluster, { bounds.minX, bounds.maxY - 1 }, { 1, 0 }, { 0, 1 }, bounds.width());
+    }
+
+    std::stable_sort(cluster.links.begin(), cluster.links.end(), [](const Link &lhs, const Link &rhs) {
+      return lhs.node < rhs.node;
+    });
+    cluster.firstLink.assign(cluster.nodes.size() + 1, 0);
+    for (const auto &link : cluster.links) { ++cluster.firstLink[link.node + 1]; }
+    for (std::size_t node = 1; node < cluster.firstLink.size(); ++node) {
+      cluster.firstLink[node] += cluster.firstLink[node - 1];
+    }
+
+    const auto count = cluster.nodes.size();
+    // one search per node covers both directions, walking the same tiles the
+    // other way enters from instead of to
+    cluster.distances.assign(count * count, GridSearch::Unreachable);
+    for (std::size_t from = 0; from < count; ++from) {
+      cluster.distances[from * count + from] = 0;
+      if (from + 1 == count) { break; }
+
+      search.expand(tiles, cluster.nodes[from], bounds, std::span{ cluster.nodes }.subspan(from + 1));
+      for (auto to = from + 1; to < count; ++to) {
+        const auto distance = search.distance(cluster.nodes[to]);
+        if (distance == GridSearch::Unreachable) { continue; }
+        cluster.distances[from * count + to] = distance;
+        cluster.distances[to * count + from] =
+          distance + tiles.cost(cluster.nodes[from]) - tiles.cost(cluster.nodes[to]);
+      }
+    }
+  }
+
+  // Both clusters of a border scan it in the same order, so they agree on
+  // where the transitions are without looking at each other.
+  void scanBorder(Cluster &cluster,
+    const GridPoint        origin,
+    const GridPoint        along,
+    const GridPoint        outward,
+    const int              length) const
+  {
+    const auto tileAt = [&](const int offset) {
+      return GridPoint{ origin.x + along.x * offset, origin.y + along.y * offset };
+    };
+
+    const auto addTransition = [&](const int offset) {
+      const auto inside = tileAt(offset);
+      const auto found  = std::find(cluster.nodes.begin(), cluster.nodes.end(), inside);
+      const auto node   = static_cast<std::uint32_t>(found - cluster.nodes.begin());
+      if (found == cluster.nodes.end()) { cluster.nodes.push_back(inside); }
+      cluster.links.push_back(Link{ node, GridPoint{ inside.x + outward.x, inside.y + outward.y }, 0, 0 });
+    };
+
+    int runStart = -1;
+    for (int offset = 0; offset <= length; ++offset) {
+      const auto inside = tileAt(offset);
+      const bool open   = offset < length && tiles.passable(inside)
+                        && tiles.passable(GridPoint{ inside.x + outward.x, inside.y + outward.y });
+
+      if (open && runStart < 0) { runStart = offset; }
+      if (!open && runStart >= 0) {
+        if (offset - runStart > LongEntrance) {
+          addTransition(runStart);
+          addTransition(offset - 1);
+        } else {
+          addTransition(runStart + (offset - runStart) / 2);
+        }
+        runStart = -1;
+      }
+    }
+  }
+
+  void resolveLinks(Cluster &cluster) const
+  {
+    for (auto &link : cluster.links) {
+      const auto &target = clusters[clusterOf(link.across)];
+      const auto  found  = std::find(target.nodes.begin(), target.nodes.end(), link.across);
+      link.targetCluster = static_cast<std::uint32_t>(clusterOf(link.across));
+      link.targetNode    = static_cast<std::uint32_t>(found - target.nodes.begin());
+    }
+  }
+
+  PathHandle compute(const GridPoint start, const GridPoint goal, Workspace &workspace) const
+  {
+    if (!tiles.contains(start) || !tiles.contains(goal) || !tiles.passable(start) || !tiles.passable(goal)) {
+      return {};
+    }
+
+    auto path = std::make_shared<Path>();
+    if (clusterOf(start) == clusterOf(goal)
+        && workspace.search.findPath(tiles, start, goal, clusters[clusterOf(start)].bounds, *path)) {
+      return path;
+    }
+
+    if (!findWaypoints(start, goal, workspace)) { return {}; }
+
+    // every hop either crosses a border or stays inside one cluster
+    const auto &waypoints = workspace.waypoints;
+    path->push_back(start);
+    for (std::size_t hop = 1; hop < waypoints.size(); ++hop) {
+      const auto from = waypoints[hop - 1];
+      const auto to   = waypoints[hop];
+      if (clusterOf(from) != clusterOf(to)) {
+        path->push_back(to);
+        continue;
+      }
+
+      path->pop_back();
+      if (!workspace.search.findPath(tiles, from, to, clusters[clusterOf(from)].bounds, *path)) { return {}; }
+    }
+    return path;
+  }
+
+  // searches the transition graph, start and goal are connected to the
+  // transitions of their clusters for the duration of the query
+  bool findWaypoints(const GridPoint start, const GridPoint goal, Workspace &workspace) const
+  {
+    const auto startNode = static_cast<std::uint32_t>(nodeClusters.size());
+    const auto goalNode  = startNode + 1;
+
+    const auto connect = [&](const GridPoint from, auto &edges, const bool reverse) {
+      const auto  index   = clusterOf(from);
+      const auto &cluster = clusters[index];
+      edges.clear();
+      workspace.search.expand(tiles, from, cluster.bounds, cluster.nodes);
+      for (std::size_t node = 0; node < cluster.nodes.size(); ++node) {
+        const auto distance = workspace.search.distance(cluster.nodes[node]);
+        if (distance == GridSearch::Unreachable) { continue; }
+        // walking a path backwards enters the other end instead
+        const auto cost = reverse ? distance + tiles.cost(from) - tiles.cost(cluster.nodes[node]) : distance;
+        edges.emplace_back(nodeOffsets[index] + static_cast<std::uint32_t>(node), cost);
+      }
+    };
+    connect(start, workspace.startEdges, false);
+    connect(goal, workspace.goalEdges, true);
+
+    const auto pointOf = [&](const std::uint32_t node) {
+      if (node == startNode) { return start; }
+      if (node == goalNode) { return goal; }
+      return nodePoints[node];
+    };
+
+    auto &route = workspace.route;
+    route.begin(nodeClusters.size() + 2);
+    route.relax(startNode, startNode, 0, manhattan(start, goal));
+
+    const auto goalCluster = clusterOf(goal);
+    while (const auto node = route.pop()) {
+      if (*node == goalNode) {
+        workspace.waypoints.clear();
+        for (auto hop = goalNode; hop != startNode; hop = route.parent(hop)) {
+          workspace.waypoints.push_back(pointOf(hop));
+        }
+        workspace.waypoints.push_back(start);
+        std::reverse(workspace.waypoints.begin(), workspace.waypoints.end());
+        return true;
+      }
+
+      const auto cost  = route.cost(*node);
+      const auto relax = [&](const std::uint32_t next, const std::uint32_t edge) {
+        if (route.improves(next, cost + edge)) {
+          route.relax(next, *node, cost + edge, manhattan(pointOf(next), goal));
+        }
+      };
+
+      if (*node == startNode) {
+        for (const auto &[next, edge] : workspace.startEdges) { relax(next, edge); }
+        continue;
+      }
+
+      const auto  index   = nodeClusters[*node];
+      const auto &cluster = clusters[index];
+      const auto  local   = *node - nodeOffsets[index];
+      const auto  count   = cluster.nodes.size();
+
+      for (std::size_t next = 0; next < count; ++next) {
+        const auto edge = cluster.distances[local * count + next];
+        if (next != local && edge != GridSearch::Unreachable) {
+          relax(nodeOffsets[index] + static_cast<std::uint32_t>(next), edge);
+        }
+      }
+
+      for (auto link = cluster.firstLink[local]; link < cluster.firstLink[local + 1]; ++link) {
+        const auto &target = cluster.links[link];
+        relax(nodeOffsets[target.targetCluster] + target.targetNode, tiles.cost(target.across));
+      }
+
+      if (index == goalCluster) {
+        for (const auto &[from, edge] : workspace.goalEdges) {
+          if (from == *node) { relax(goalNode, edge); }
+        }
+      }
+    }
+
+    return false;
+  }
+
+  std::optional<PathHandle> lookup(const std::uint64_t key)
+  {
+    if (const auto found = cache.find(key); found != cache.end()) {
+      ++statistics.hits;
+      return found->second;
+    }
+    ++statistics.misses;
+    return {};
+  }
+
+  void store(const std::uint64_t key, const PathHandle &path)
+  {
+    // crude, but keeps memory bounded without bookkeeping on every hit
+    if (cache.size() >= capacity) { clearCache(); }
+    cache.insert_or_assign(key, path);
+    if (!path) { return; }
+
+    auto last = clusters.size();
+    for (const auto &point : *path) {
+      if (const auto index = clusterOf(point); index != last) {
+        clusterPaths[index].push_back(key);
+        last = index;
+      }
+    }
+  }
+
+  // drops the cached paths of a cluster that run through tile
+  void invalidate(const std::size_t cluster, const GridPoint tile)
+  {
+    std::erase_if(clusterPaths[cluster], [&](const std::uint64_t key) {
+      const auto found = cache.find(key);
+      if (found == cache.end()) { return true; }
+
+      // a key may have been stored again since, now without a path
+      if (!found->second) { return true; }
+
+      const auto &path = *found->second;
+      if (std::find(path.begin(), path.end(), tile) != path.end()) {
+        cache.erase(found);
+        ++statistics.invalidated;
+        return true;
+      }
+      return false;
+    });
+  }
+
+  void invalidateAll()
+  {
+    statistics.invalidated += cache.size();
+    clearCache();
+  }
+
+  TileGrid                   tiles;
+  int                        clusterExtent;
+  int                        clusterColumns{ 0 };
+  int                        clusterRows{ 0 };
+  std::vector<Cluster>       clusters;
+  std::vector<std::size_t>   dirty;
+  std::vector<std::uint32_t> nodeOffsets;// first node id of each cluster
+  std::vector<std::uint32_t> nodeClusters;// cluster of each node id
+  std::vector<GridPoint>     nodePoints;// tile of each node id
+
+  std::size_t                                   capacity;
+  std::unordered_map<std::uint64_t, PathHandle> cache;
+  std::vector<std::vector<std::uint64_t>>       clusterPaths;// cached keys by the clusters they cross
+  Stats                                         statistics;
+
+  std::vector<std::size_t>                       batchMisses;
+  std::vector<std::size_t>                       batchOwners;
+  std::vector<PathHandle>                        batchPaths;
+  std::unordered_map<std::uint64_t, std::size_t> batchPending;
+
+  std::mutex                              workspaceMutex;
+  std::vector<std::unique_ptr<Workspace>> workspaces;
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_PATHFINDING_HPP
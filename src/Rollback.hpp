@@ -0,0 +1,317 @@
+#ifndef MYPROJECT_ROLLBACK_HPP
+#define MYPROJECT_ROLLBACK_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace Game {
+
+// Unreliable, unordered datagram transport between two peers.
+class Transport
+{
+public:
+  Transport()                  = default;
+  Transport(const Transport &) = delete;
+  Transport(Transport &&)      = delete;
+  Transport &operator=(const Transport &) = delete;
+  Transport &operator=(Transport &&) = delete;
+  virtual ~Transport()               = default;
+
+  virtual void                                     send(std::span<const std::uint8_t> datagram) = 0;
+  virtual std::optional<std::vector<std::uint8_t>> receive()                                      = 0;
+};
+
+// Both ends of an in-process connection, mostly for tests.
+class MemoryTransport : public Transport
+{
+public:
+  static std::pair<std::unique_ptr<MemoryTransport>, std::unique_ptr<MemoryTransport>> makePair()
+  {
+    auto link = std::make_shared<Link>();
+    return { std::unique_ptr<MemoryTransport>(new MemoryTransport(link, 0)),
+             std::unique_ptr<MemoryTransport>(new MemoryTransport(link, 1)) };
+  }
+
+  void send(std::span<const std::uint8_t> datagram) override
+  {
+    link->queues[1 - side].emplace_back(datagram.begin(), datagram.end());
+  }
+
+  std::optional<std::vector<std::uint8_t>> receive() override
+  {
+    auto &queue = link->queues[side];
+    if (queue.empty()) { return {}; }
+    auto datagram = std::move(queue.front());
+    queue.pop_front();
+    return datagram;
+  }
+
+private:
+  struct Link
+  {
+    std::array<std::deque<std::vector<std::uint8_t>>, 2> queues;
+  };
+
+  MemoryTransport(std::shared_ptr<Link> shared, const std::size_t end) : link{ std::move(shared) }, side{ end } {}
+
+  std::shared_ptr<Link> link;
+  std::size_t           side;
+};
+
+// Wraps a transport and delays, reorders and drops outgoing datagrams.
+class SimulatedNetwork : public Transport
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct Conditions
+  {
+    std::chrono::milliseconds latency{ 0 };
+    std::chrono::milliseconds jitter{ 0 };
+    double                    loss{ 0.0 };// 0 to 1
+  };
+
+  SimulatedNetwork(Transport &          wrapped,
+    const Conditions &                   networkConditions,
+    const std::uint32_t                  seed       = 5489,
+    std::function<clock::time_point()>   timeSource = [] { return clock::now(); })
+    : inner{ wrapped }, conditions{ networkConditions }, rng{ seed }, now{ std::move(timeSource) }
+  {}
+
+  void setConditions(const Conditions &networkConditions) { conditions = networkConditions; }
+
+  void send(std::span<const std::uint8_t> datagram) override
+  {
+    flush();
+    if (std::bernoulli_distribution{ conditions.loss }(rng)) { return; }
+
+    const auto jitter = conditions.jitter.count() == 0
+                          ? 0
+                          : std::uniform_int_distribution<std::int64_t>{ -conditions.jitter.count(),
+                              conditions.jitter.count() }(rng);
+    const auto delay =
+      std::max(conditions.latency + std::chrono::milliseconds{ jitter }, std::chrono::milliseconds{ 0 });
+    inFlight.emplace(now() + delay, std::vector<std::uint8_t>(datagram.begin(), datagram.end()));
+  }
+
+  std::optional<std::vector<std::uint8_t>> receive() override
+  {
+    flush();
+    return inner.receive();
+  }
+
+  // hands every datagram that has arrived to the wrapped transport
+  void flush()
+  {
+    const auto current = now();
+    while (!inFlight.empty() && inFlight.begin()->first <= current) {
+      inner.send(inFlight.begin()->second);
+      inFlight.erase(inFlight.begin());
+    }
+  }
+
+private:
+  Transport &                                                 inner;
+  Conditions                                                  conditions;
+  std::mt19937                                                rng;
+  std::function<clock::time_point()>                          now;
+  std::multimap<clock::time_point, std::vector<std::uint8_t>> inFlight;
+};
+
+struct RollbackStats
+{
+  using clock = std::chrono::steady_clock;
+
+  std::uint64_t   ticks{ 0 };
+  std::uint64_t   rollbacks{ 0 };
+  std::uint64_t   resimulatedTicks{ 0 };
+  std::uint64_t   stalls{ 0 };
+  std::uint64_t   packetsSent{ 0 };
+  std::uint64_t   packetsReceived{ 0 };
+  std::uint64_t   packetsRejected{ 0 };
+  clock::duration lastResimulation{};
+  clock::duration maxResimulation{};
+  clock::duration totalResimulation{};
+};
+
+// Two player rollback session. Every tick both players contribute one Input;
+// the remote input is predicted as Input{} until it arrives. When a late input
+// differs from the prediction the session restores the snapshot taken before
+// that tick and re-simulates up to the present.
+template<typename State, typename Input> class RollbackSession
+{
+public:
+  static constexpr std::size_t   Players     = 2;
+  static constexpr std::uint32_t MaxRollback = 8;// ticks simulated ahead of the remote before stalling
+  static constexpr std::uint32_t MaxResend   = 32;// unacknowledged inputs repeated in every packet
+
+  using Inputs   = std::array<Input, Players>;
+  using Simulate = std::function<void(State &, const Inputs &)>;
+
+  RollbackSession(State initial, const std::size_t player, Transport &peer, Simulate simulation)
+    : current{ std::move(initial) }, localPlayer{ player }, transport{ peer }, simulate{ std::move(simulation) }
+  {
+    if (localPlayer >= Players) { throw std::invalid_argument("player must be 0 or 1"); }
+  }
+
+  // Simulates one tick with localInput. Returns false, without consuming the
+  // input, if the session is too far ahead of the remote peer.
+  bool advance(Input localInput)
+  {
+    poll();
+
+    if (tick >= remoteConfirmed + MaxRollback) {
+      ++statistics.stalls;
+      sendInputs();
+      return false;
+    }
+
+    auto &frame               = frameFor(tick);
+    frame.inputs[localPlayer] = std::move(localInput);
+    if (tick >= remoteConfirmed) { frame.inputs[remotePlayer()] = Input{}; }
+
+    snapshots[tick % snapshots.size()] = current;
+    simulate(current, frame.inputs);
+    ++tick;
+    ++statistics.ticks;
+
+    sendInputs();
+    return true;
+  }
+
+  // receives remote inputs and rolls back if a prediction was wrong
+  void poll()
+  {
+    std::optional<std::uint32_t> rollbackFrom;
+
+    while (const auto datagram = transport.receive()) {
+      if (!receiveInputs(*datagram, rollbackFrom)) { ++statistics.packetsRejected; }
+    }
+
+    if (rollbackFrom) { rollback(*rollbackFrom); }
+  }
+
+  // for frames that do not advance, keeps resending unacknowledged inputs
+  void keepAlive()
+  {
+    poll();
+    if (remoteAck < tick || remoteConfirmed < tick) { sendInputs(); }
+  }
+
+  [[nodiscard]] const State &        state() const noexcept { return current; }
+  [[nodiscard]] std::uint32_t        currentTick() const noexcept { return tick; }
+  [[nodiscard]] std::uint32_t        confirmedTick() const noexcept { return std::min(tick, remoteConfirmed); }
+  [[nodiscard]] const RollbackStats &stats() const noexcept { return statistics; }
+
+private:
+  static constexpr std::uint32_t HistorySize = 128;
+
+  struct Frame
+  {
+    std::uint32_t tick{ 0 };
+    Inputs        inputs{};
+  };
+
+  [[nodiscard]] std::size_t remotePlayer() const noexcept { return 1 - localPlayer; }
+
+  Frame &frameFor(const std::uint32_t frameTick)
+  {
+    auto &frame = history[frameTick % HistorySize];
+    if (frame.tick != frameTick) { frame = Frame{ frameTick, {} }; }
+    return frame;
+  }
+
+  void sendInputs()
+  {
+    const auto first = std::max(remoteAck, tick > HistorySize ? tick - HistorySize : 0);
+    const auto last  = std::min(tick, first + MaxResend);
+
+    nlohmann::json inputs = nlohmann::json::array();
+    for (auto inputTick = first; inputTick < last; ++inputTick) {
+      inputs.push_back(frameFor(inputTick).inputs[localPlayer]);
+    }
+
+    const nlohmann::json packet{ { "p", localPlayer }, { "t", first }, { "a", remoteConfirmed }, { "i", inputs } };
+    transport.send(nlohmann::json::to_cbor(packet));
+    ++statistics.packetsSent;
+  }
+
+  bool receiveInputs(const std::vector<std::uint8_t> &datagram, std::optional<std::uint32_t> &rollbackFrom)
+  {
+    try {
+      const auto packet = nlohmann::json::from_cbor(datagram);
+      if (packet.at("p").get<std::size_t>() != remotePlayer()) { return false; }
+
+      ++statistics.packetsReceived;
+      remoteAck = std::max(remoteAck, packet.at("a").get<std::uint32_t>());
+
+      auto inputTick = packet.at("t").get<std::uint32_t>();
+      for (const auto &value : packet.at("i")) {
+        // inputs must be confirmed in order, a gap waits for the resend
+        if (inputTick > remoteConfirmed) { break; }
+
+        if (inputTick == remoteConfirmed) {
+          auto  input = value.get<Input>();
+          auto &frame = frameFor(inputTick);
+          if (inputTick < tick && !(frame.inputs[remotePlayer()] == input)) {
+            rollbackFrom = std::min(rollbackFrom.value_or(inputTick), inputTick);
+          }
+          frame.inputs[remotePlayer()] = std::move(input);
+          ++remoteConfirmed;
+        }
+        ++inputTick;
+      }
+      return true;
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+
+  void rollback(const std::uint32_t from)
+  {
+    const auto start = RollbackStats::clock::now();
+
+    current = snapshots[from % snapshots.size()];
+    for (auto resimulated = from; resimulated < tick; ++resimulated) {
+      snapshots[resimulated % snapshots.size()] = current;
+      simulate(current, frameFor(resimulated).inputs);
+      ++statistics.resimulatedTicks;
+    }
+
+    const auto elapsed = RollbackStats::clock::now() - start;
+    ++statistics.rollbacks;
+    statistics.lastResimulation = elapsed;
+    statistics.maxResimulation  = std::max(statistics.maxResimulation, elapsed);
+    statistics.totalResimulation += elapsed;
+  }
+
+  State                              current;
+  std::size_t                        localPlayer;
+  Transport &                        transport;
+  Simulate                           simulate;
+  std::uint32_t                      tick{ 0 };
+  std::uint32_t                      remoteConfirmed{ 0 };// remote inputs are known for all ticks before this
+  std::uint32_t                      remoteAck{ 0 };// the remote knows our inputs for all ticks before this
+  std::array<Frame, HistorySize>     history{};
+  std::array<State, MaxRollback + 1> snapshots{};
+  RollbackStats                      statistics;
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_ROLLBACK_HPP
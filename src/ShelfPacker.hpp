@@ -0,0 +1,77 @@
+#ifndef MYPROJECT_SHELFPACKER_HPP
+#define MYPROJECT_SHELFPACKER_HPP
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace Game {
+
+struct PackedRect
+{
+  std::uint32_t x{ 0 };
+  std::uint32_t y{ 0 };
+  std::uint32_t width{ 0 };
+  std::uint32_t height{ 0 };
+
+  [[nodiscard]] constexpr bool operator==(const PackedRect &) const noexcept = default;
+};
+
+// Packs rectangles into rows ("shelves") as tall as the tallest rectangle
+// that opened them. Sprites come in a handful of heights, so a rectangle
+// goes to the fitting shelf that wastes the least height.
+class ShelfPacker
+{
+public:
+  ShelfPacker(const std::uint32_t pageWidth, const std::uint32_t pageHeight) : width{ pageWidth }, height{ pageHeight }
+  {}
+
+  [[nodiscard]] std::optional<PackedRect> insert(const std::uint32_t rectWidth, const std::uint32_t rectHeight)
+  {
+    if (rectWidth == 0 || rectHeight == 0 || rectWidth > width || rectHeight > height) { return {}; }
+
+    Shelf *best = nullptr;
+    for (auto &shelf : shelves) {
+      if (shelf.height < rectHeight || width - shelf.used < rectWidth) { continue; }
+      if (best == nullptr || shelf.height < best->height) { best = &shelf; }
+    }
+
+    if (best == nullptr) {
+      if (height - top < rectHeight) { return {}; }
+      best = &shelves.emplace_back(Shelf{ top, rectHeight, 0 });
+      top += rectHeight;
+    }
+
+    const PackedRect rect{ best->used, best->y, rectWidth, rectHeight };
+    best->used += rectWidth;
+    area += std::uint64_t{ rectWidth } * rectHeight;
+    return rect;
+  }
+
+  // share of the page covered by packed rectangles
+  [[nodiscard]] double occupancy() const noexcept
+  {
+    return static_cast<double>(area) / (static_cast<double>(width) * static_cast<double>(height));
+  }
+
+  [[nodiscard]] std::uint32_t pageWidth() const noexcept { return width; }
+  [[nodiscard]] std::uint32_t pageHeight() const noexcept { return height; }
+
+private:
+  struct Shelf
+  {
+    std::uint32_t y;
+    std::uint32_t height;
+    std::uint32_t used;
+  };
+
+  std::uint32_t      width;
+  std::uint32_t      height;
+  std::uint32_t      top{ 0 };
+  std::uint64_t      area{ 0 };
+  std::vector<Shelf> shelves;
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_SHELFPACKER_HPP
@@ -0,0 +1,101 @@
+#ifndef MYPROJECT_SIMULATION_HPP
+#define MYPROJECT_SIMULATION_HPP
+
+#include <optional>
+
+#include "ECS.hpp"
+#include "SpatialHash.hpp"
+#include "ThreadPool.hpp"
+
+namespace Game {
+
+// The deterministic part of the game: the ECS world, the map objects in it
+// and what the players pointed at. Given the same inputs every peer computes
+// the same Simulation, so it is all netplay snapshots and rolls back; input
+// devices, latency stamps and the event queue stay in GameState.
+class Simulation
+{
+public:
+  // the area GameLoop fills with map objects
+  static constexpr int MapWidth  = 1024;
+  static constexpr int MapHeight = 768;
+
+  // component of every entity that has a place in the world index
+  struct MapObject
+  {
+    AABB                             bounds;
+    SpatialHash<ECS::Entity>::Handle handle;
+  };
+
+  // map objects that slide back and forth along x, speed is per tick
+  struct Drift
+  {
+    float speed;
+    float minX;
+    float maxX;
+  };
+
+  // one bucket per cell of the map instead of SpatialHash's 4096, every snapshot copies them all
+  Simulation() : worldIndex{ static_cast<float>(CellSize), (MapWidth / CellSize) * (MapHeight / CellSize) } {}
+
+  // One tick. Systems only see the ECS world, so the index is brought up to
+  // date with MapObject::bounds afterwards.
+  void step(const ECS::Scheduler &systems, ThreadPool &pool)
+  {
+    systems.run(world, pool);
+    world.each<const MapObject>([&](const MapObject &object) { worldIndex.move(object.handle, object.bounds); });
+  }
+
+  ECS::Entity addMapObject(const AABB &bounds)
+  {
+    const auto entity = world.create(MapObject{ bounds, SpatialHash<ECS::Entity>::InvalidHandle });
+    const auto handle = worldIndex.insert(bounds, entity);
+    if (auto *object = world.get<MapObject>(entity); object != nullptr) { object->handle = handle; }
+    return entity;
+  }
+
+  void moveMapObject(const ECS::Entity entity, const AABB &bounds)
+  {
+    if (auto *object = world.get<MapObject>(entity); object != nullptr) {
+      object->bounds = bounds;
+      worldIndex.move(object->handle, bounds);
+    }
+  }
+
+  void removeMapObject(const ECS::Entity entity)
+  {
+    if (const auto *object = world.get<MapObject>(entity); object != nullptr) { worldIndex.erase(object->handle); }
+    world.destroy(entity);
+  }
+
+  // the smallest object under the point, only looks at a single grid cell
+  [[nodiscard]] std::optional<ECS::Entity> pick(const int x, const int y) const
+  {
+    std::optional<ECS::Entity> found;
+    float                      foundArea = 0.0F;
+    worldIndex.queryPoint(
+      static_cast<float>(x), static_cast<float>(y), [&](auto, const ECS::Entity entity, const AABB &box) {
+        if (!found || box.area() < foundArea) {
+          found     = entity;
+          foundArea = box.area();
+        }
+      });
+    return found;
+  }
+
+  void hover(const int x, const int y) { hovered = pick(x, y); }
+  void select(const int x, const int y) { selected = pick(x, y); }
+
+  // map objects, NPCs, projectiles; see ECS.hpp
+  ECS::World                 world;
+  SpatialHash<ECS::Entity>   worldIndex;
+  std::optional<ECS::Entity> hovered;
+  std::optional<ECS::Entity> selected;
+
+private:
+  static constexpr int CellSize = 64;
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_SIMULATION_HPP
@@ -0,0 +1,435 @@
+#ifndef MYPROJECT_SPATIALHASH_HPP
+#define MYPROJECT_SPATIALHASH_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace Game {
+
+struct AABB
+{
+  float minX;
+  float minY;
+  float maxX;
+  float maxY;
+
+  [[nodiscard]] constexpr bool contains(const float x, const float y) const noexcept
+  {
+    return x >= minX && x <= maxX && y >= minY && y <= maxY;
+  }
+
+  [[nodiscard]] constexpr bool intersects(const AABB &other) const noexcept
+  {
+    return minX <= other.maxX && maxX >= other.minX && minY <= other.maxY && maxY >= other.minY;
+  }
+
+  [[nodiscard]] constexpr bool intersects(const float x, const float y, const float radius) const noexcept
+  {
+    const auto dx = x - std::clamp(x, minX, maxX);
+    const auto dy = y - std::clamp(y, minY, maxY);
+    return dx * dx + dy * dy <= radius * radius;
+  }
+
+  [[nodiscard]] constexpr float width() const noexcept { return maxX - minX; }
+  [[nodiscard]] constexpr float height() const noexcept { return maxY - minY; }
+  [[nodiscard]] constexpr float area() const noexcept { return width() * height(); }
+};
+
+// Loose quadtree with a fixed depth stored as flat per level arrays. An object
+// lives in the deepest node at least as big as the object that contains its
+// center, node bounds are loosened by half a node on every side.
+class LooseQuadtree
+{
+public:
+  LooseQuadtree(const AABB &worldBounds, const std::size_t treeDepth) : bounds{ worldBounds }, depth{ treeDepth }
+  {
+    if (depth == 0 || depth > 12) { throw std::invalid_argument("quadtree depth must be in [1, 12]"); }
+
+    std::size_t total = 0;
+    for (std::size_t level = 0; level < depth; ++level) {
+      levelOffsets.push_back(total);
+      total += gridSize(level) * gridSize(level);
+    }
+    nodes.resize(total);
+  }
+
+  struct Location
+  {
+    std::size_t level;
+    std::size_t node;
+  };
+
+  [[nodiscard]] Location locate(const AABB &box) const noexcept
+  {
+    const auto extent = std::max(box.width(), box.height());
+    std::size_t level = 0;
+    while (level + 1 < depth && nodeWidth(level + 1) >= extent && nodeHeight(level + 1) >= extent) { ++level; }
+
+    const auto cx = column(level, (box.minX + box.maxX) * 0.5F);
+    const auto cy = row(level, (box.minY + box.maxY) * 0.5F);
+    return { level, levelOffsets[level] + cy * gridSize(level) + cx };
+  }
+
+  void insert(const Location &location, const std::uint32_t id) { nodes[location.node].push_back(id); }
+
+  void erase(const Location &location, const std::uint32_t id) { eraseFrom(nodes[location.node], id); }
+
+  // calls func(id) for every object in a node whose loose bounds touch box
+  template<typename Func> void visit(const AABB &box, Func &&func) const
+  {
+    for (std::size_t level = 0; level < depth; ++level) {
+      const auto halfWidth  = nodeWidth(level) * 0.5F;
+      const auto halfHeight = nodeHeight(level) * 0.5F;
+      const auto minX       = column(level, box.minX - halfWidth);
+      const auto maxX       = column(level, box.maxX + halfWidth);
+      const auto minY       = row(level, box.minY - halfHeight);
+      const auto maxY       = row(level, box.maxY + halfHeight);
+
+      for (auto y = minY; y <= maxY; ++y) {
+        for (auto x = minX; x <= maxX; ++x) {
+          for (const auto id : nodes[levelOffsets[level] + y * gridSize(level) + x]) { func(id); }
+        }
+      }
+    }
+  }
+
+  static void eraseFrom(std::vector<std::uint32_t> &ids, const std::uint32_t id)
+  {
+    const auto found = std::find(ids.begin(), ids.end(), id);
+    if (found != ids.end()) {
+      *found = ids.back();
+      ids.pop_back();
+    }
+  }
+
+private:
+  [[nodiscard]] static constexpr std::size_t gridSize(const std::size_t level) noexcept
+  {
+    return std::size_t{ 1 } << level;
+  }
+
+  [[nodiscard]] float nodeWidth(const std::size_t level) const noexcept
+  {
+    return bounds.width() / static_cast<float>(gridSize(level));
+  }
+
+  [[nodiscard]] float nodeHeight(const std::size_t level) const noexcept
+  {
+    return bounds.height() / static_cast<float>(gridSize(level));
+  }
+
+  [[nodiscard]] std::size_t column(const std::size_t level, const float x) const noexcept
+  {
+    return cell(level, (x - bounds.minX) / nodeWidth(level));
+  }
+
+  [[nodiscard]] std::size_t row(const std::size_t level, const float y) const noexcept
+  {
+    return cell(level, (y - bounds.minY) / nodeHeight(level));
+  }
+
+  [[nodiscard]] static std::size_t cell(const std::size_t level, const float position) noexcept
+  {
+    const auto clamped = std::clamp(position, 0.0F, static_cast<float>(gridSize(level) - 1));
+    return static_cast<std::size_t>(clamped);
+  }
+
+  AABB                                    bounds;
+  std::size_t                             depth;
+  std::vector<std::size_t>                levelOffsets;
+  std::vector<std::vector<std::uint32_t>> nodes;
+};
+
+// Uniform grid hashed into a fixed number of buckets. Objects are stored in
+// every cell they overlap; objects spanning more than largeObjectCells cells
+// per axis go to an optional loose quadtree instead.
+// Queries take a visitor and never allocate.
+template<typename Value> class SpatialHash
+{
+public:
+  using Handle = std::uint32_t;
+
+  static constexpr Handle InvalidHandle = std::numeric_limits<Handle>::max();
+
+  struct Pair
+  {
+    Handle first;
+    Handle second;
+  };
+
+  explicit SpatialHash(const float gridCellSize = 64.0F, const std::size_t buckets = 4096)
+    : cellSize{ gridCellSize }, inverseCellSize{ 1.0F / gridCellSize }, bucketMask{ std::bit_ceil(buckets) - 1 },
+      grid(bucketMask + 1)
+  {
+    if (!(cellSize > 0.0F)) { throw std::invalid_argument("cell size must be positive"); }
+  }
+
+  void enableLooseQuadtree(const AABB &worldBounds, const std::size_t depth = 8, const int largeObjectCells = 4)
+  {
+    if (!objects.empty()) { throw std::logic_error("the quadtree must be enabled before objects are inserted"); }
+    quadtree.emplace(worldBounds, depth);
+    largeCells = largeObjectCells;
+  }
+
+  Handle insert(const AABB &box, Value value)
+  {
+    Handle handle = InvalidHandle;
+    if (!freeHandles.empty()) {
+      handle = freeHandles.back();
+      freeHandles.pop_back();
+    } else {
+      handle = static_cast<Handle>(objects.size());
+      objects.emplace_back();
+    }
+
+    auto &object = objects[handle];
+    object       = Object{ box, std::move(value), cellRange(box), true, false, {} };
+    link(handle);
+    ++objectCount;
+    return handle;
+  }
+
+  void erase(const Handle handle)
+  {
+    if (!valid(handle)) { return; }
+    unlink(handle);
+    objects[handle].live = false;
+    freeHandles.push_back(handle);
+    --objectCount;
+  }
+
+  // cheap when the object stays within the same cells
+  void move(const Handle handle, const AABB &box)
+  {
+    if (!valid(handle)) { return; }
+
+    auto &     object = objects[handle];
+    const auto cells  = cellRange(box);
+
+    if (cells == object.cells && isLarge(cells) == object.large
+        && (!object.large || quadtree->locate(box).node == object.node.node)) {
+      object.box = box;
+      return;
+    }
+
+    unlink(handle);
+    object.box   = box;
+    object.cells = cells;
+    link(handle);
+  }
+
+  [[nodiscard]] bool valid(const Handle handle) const noexcept
+  {
+    return handle < objects.size() && objects[handle].live;
+  }
+
+  [[nodiscard]] const AABB & bounds(const Handle handle) const { return objects[handle].box; }
+  [[nodiscard]] const Value &value(const Handle handle) const { return objects[handle].value; }
+  [[nodiscard]] std::size_t  size() const noexcept { return objectCount; }
+
+  // func(handle, value, box) for every object containing the point, O(objects in one cell)
+  template<typename Func> void queryPoint(const float x, const float y, Func &&func) const
+  {
+    for (const auto handle : grid[bucket(cellCoord(x), cellCoord(y))]) {
+      const auto &object = objects[handle];
+      if (object.box.contains(x, y)) { func(handle, object.value, object.box); }
+    }
+
+    if (quadtree) {
+      quadtree->visit(AABB{ x, y, x, y }, [&](const Handle handle) {
+        const auto &object = objects[handle];
+        if (object.box.contains(x, y)) { func(handle, object.value, object.box); }
+      });
+    }
+  }
+
+  // func(handle, value, box) once for every object intersecting box
+  template<typename Func> void queryBox(const AABB &box, Func &&func) const
+  {
+    visitCandidates(box, [&](const Handle handle) {
+      const auto &object = objects[handle];
+      if (object.box.intersects(box)) { func(handle, object.value, object.box); }
+    });
+  }
+
+  // func(handle, value, box) once for every object within radius of (x, y)
+  template<typename Func> void queryRadius(const float x, const float y, const float radius, Func &&func) const
+  {
+    visitCandidates(AABB{ x - radius, y - radius, x + radius, y + radius }, [&](const Handle handle) {
+      const auto &object = objects[handle];
+      if (object.box.intersects(x, y, radius)) { func(handle, object.value, object.box); }
+    });
+  }
+
+  // Broad phase: every pair of intersecting objects exactly once. Buckets are
+  // split across the pool, results are merged into pairs.
+  void overlappingPairs(ThreadPool &pool, std::vector<Pair> &pairs) const
+  {
+    pairs.clear();
+
+    constexpr std::size_t BucketsPerBlock = 256;
+    const auto            blockCount      = (grid.size() + BucketsPerBlock - 1) / BucketsPerBlock;
+    blockPairs.resize(blockCount + 1);
+
+    pool.parallelFor(grid.size(), BucketsPerBlock, [&](const std::size_t begin, const std::size_t end) {
+      auto &out = blockPairs[begin / BucketsPerBlock];
+      out.clear();
+      for (auto index = begin; index < end; ++index) { bucketPairs(index, out); }
+    });
+
+    auto &largeOut = blockPairs.back();
+    largeOut.clear();
+    for (Handle handle = 0; handle < objects.size(); ++handle) {
+      const auto &object = objects[handle];
+      if (!object.live || !object.large) { continue; }
+
+      visitCandidates(object.box, [&](const Handle other) {
+        // large-large pairs are reported from the lower handle only
+        if (other == handle || (objects[other].large && other < handle)) { return; }
+        if (object.box.intersects(objects[other].box)) { largeOut.push_back(Pair{ handle, other }); }
+      });
+    }
+
+    for (const auto &block : blockPairs) { pairs.insert(pairs.end(), block.begin(), block.end()); }
+  }
+
+private:
+  struct CellRange
+  {
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+
+    [[nodiscard]] constexpr bool operator==(const CellRange &) const = default;
+  };
+
+  struct Object
+  {
+    AABB                    box;
+    Value                   value;
+    CellRange               cells;
+    bool                    live;
+    bool                    large;
+    LooseQuadtree::Location node;
+  };
+
+  [[nodiscard]] int cellCoord(const float position) const noexcept
+  {
+    return static_cast<int>(std::floor(position * inverseCellSize));
+  }
+
+  [[nodiscard]] CellRange cellRange(const AABB &box) const noexcept
+  {
+    return { cellCoord(box.minX), cellCoord(box.minY), cellCoord(box.maxX), cellCoord(box.maxY) };
+  }
+
+  [[nodiscard]] std::size_t bucket(const int x, const int y) const noexcept
+  {
+    const auto hash = static_cast<std::size_t>(static_cast<std::uint32_t>(x) * 73856093U)
+                      ^ static_cast<std::size_t>(static_cast<std::uint32_t>(y) * 19349663U);
+    return hash & bucketMask;
+  }
+
+  [[nodiscard]] bool isLarge(const CellRange &cells) const noexcept
+  {
+    return quadtree && (cells.maxX - cells.minX >= largeCells || cells.maxY - cells.minY >= largeCells);
+  }
+
+  void link(const Handle handle)
+  {
+    auto &object = objects[handle];
+    object.large = isLarge(object.cells);
+    if (object.large) {
+      object.node = quadtree->locate(object.box);
+      quadtree->insert(object.node, handle);
+      return;
+    }
+
+    for (auto y = object.cells.minY; y <= object.cells.maxY; ++y) {
+      for (auto x = object.cells.minX; x <= object.cells.maxX; ++x) {
+        // neighbouring cells can share a bucket, keep each handle once per bucket
+        auto &handles = grid[bucket(x, y)];
+        if (std::find(handles.begin(), handles.end(), handle) == handles.end()) { handles.push_back(handle); }
+      }
+    }
+  }
+
+  void unlink(const Handle handle)
+  {
+    const auto &object = objects[handle];
+    if (object.large) {
+      quadtree->erase(object.node, handle);
+      return;
+    }
+
+    for (auto y = object.cells.minY; y <= object.cells.maxY; ++y) {
+      for (auto x = object.cells.minX; x <= object.cells.maxX; ++x) {
+        LooseQuadtree::eraseFrom(grid[bucket(x, y)], handle);
+      }
+    }
+  }
+
+  // Calls func(handle) once per grid or quadtree object that may intersect box.
+  // A grid object spanning several cells is only reported from the first cell
+  // it shares with box, so no visited set is needed.
+  template<typename Func> void visitCandidates(const AABB &box, Func &&func) const
+  {
+    const auto range = cellRange(box);
+    for (auto y = range.minY; y <= range.maxY; ++y) {
+      for (auto x = range.minX; x <= range.maxX; ++x) {
+        for (const auto handle : grid[bucket(x, y)]) {
+          const auto &cells = objects[handle].cells;
+          if (std::max(cells.minX, range.minX) == x && std::max(cells.minY, range.minY) == y && cells.maxX >= x
+              && cells.maxY >= y) {
+            func(handle);
+          }
+        }
+      }
+    }
+
+    if (quadtree) { quadtree->visit(box, func); }
+  }
+
+  // pairs in one bucket; a pair is owned by the bucket of the first cell both objects share
+  void bucketPairs(const std::size_t index, std::vector<Pair> &out) const
+  {
+    const auto &handles = grid[index];
+    for (std::size_t first = 0; first < handles.size(); ++first) {
+      const auto &a = objects[handles[first]];
+      for (auto second = first + 1; second < handles.size(); ++second) {
+        const auto &b = objects[handles[second]];
+        if (!a.box.intersects(b.box)) { continue; }
+
+        const auto x = std::max(a.cells.minX, b.cells.minX);
+        const auto y = std::max(a.cells.minY, b.cells.minY);
+        if (bucket(x, y) == index) { out.push_back(Pair{ handles[first], handles[second] }); }
+      }
+    }
+  }
+
+  float                                  cellSize;
+  float                                  inverseCellSize;
+  std::size_t                            bucketMask;
+  std::vector<std::vector<Handle>>       grid;
+  std::optional<LooseQuadtree>           quadtree;
+  int                                    largeCells{ 4 };
+  std::vector<Object>                    objects;
+  std::vector<Handle>                    freeHandles;
+  std::size_t                            objectCount{ 0 };
+  mutable std::vector<std::vector<Pair>> blockPairs;
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_SPATIALHASH_HPP
@@ -0,0 +1,250 @@
+#ifndef MYPROJECT_SPRITEBATCH_HPP
+#define MYPROJECT_SPRITEBATCH_HPP
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/VertexArray.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numbers>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "ShelfPacker.hpp"
+
+namespace Game {
+
+// a packed image: the atlas page it lives on and its pixels on that page
+struct AtlasRegion
+{
+  std::uint16_t page{ 0 };
+  sf::IntRect   rect;
+};
+
+// Packs loose images into a few large textures so sprites using any of them
+// can share one draw call.
+class TextureAtlas
+{
+public:
+  // images are surrounded by a copy of their edge pixels, so filtering near a
+  // region border never samples a neighbouring image
+  static constexpr std::uint32_t Padding = 1;
+
+  explicit TextureAtlas(const std::uint32_t pageSize = 2048) : size{ pageSize } {}
+
+  // needs the GL context of the main thread
+  AtlasRegion add(const sf::Image &image)
+  {
+    // querying the limit needs that context too, so it waits for the first image
+    if (pages.empty()) { size = std::min<std::uint32_t>(size, sf::Texture::getMaximumSize()); }
+
+    const auto imageSize = image.getSize();
+    const auto width     = imageSize.x + 2 * Padding;
+    const auto height    = imageSize.y + 2 * Padding;
+    if (imageSize.x == 0 || imageSize.y == 0 || width > size || height > size) {
+      throw std::invalid_argument("image does not fit an atlas page");
+    }
+
+    std::size_t               page = 0;
+    std::optional<PackedRect> placed;
+    while (page < pages.size() && !(placed = pages[page].packer.insert(width, height))) { ++page; }
+
+    if (!placed) {
+      if (pages.size() > MaxPages) { throw std::length_error("texture atlas is full"); }
+      auto texture = std::make_unique<sf::Texture>();
+      if (!texture->create(size, size)) { throw std::runtime_error("unable to create atlas texture"); }
+      pages.push_back(Page{ std::move(texture), ShelfPacker{ size, size } });
+      placed = pages.back().packer.insert(width, height);
+    }
+
+    pages[page].texture->update(extruded(image), placed->x, placed->y);
+    return { static_cast<std::uint16_t>(page),
+      sf::IntRect(static_cast<int>(placed->x + Padding),
+        static_cast<int>(placed->y + Padding),
+        static_cast<int>(imageSize.x),
+        static_cast<int>(imageSize.y)) };
+  }
+
+  [[nodiscard]] const sf::Texture &texture(const std::size_t page) const { return *pages.at(page).texture; }
+  [[nodiscard]] std::size_t        pageCount() const noexcept { return pages.size(); }
+  [[nodiscard]] std::uint32_t      pageSize() const noexcept { return size; }
+  [[nodiscard]] double             occupancy(const std::size_t page) const { return pages.at(page).packer.occupancy(); }
+
+private:
+  static constexpr std::size_t MaxPages = 0xFFFF;
+
+  struct Page
+  {
+    std::unique_ptr<sf::Texture> texture;// sprite batches keep pointers to it
+    ShelfPacker                  packer;
+  };
+
+  static sf::Image extruded(const sf::Image &image)
+  {
+    const auto width  = image.getSize().x;
+    const auto height = image.getSize().y;
+    const auto w      = static_cast<int>(width);
+    const auto h      = static_cast<int>(height);
+
+    sf::Image padded;
+    padded.create(width + 2 * Padding, height + 2 * Padding);
+    padded.copy(image, Padding, Padding);
+    padded.copy(image, Padding, 0, sf::IntRect(0, 0, w, 1));
+    padded.copy(image, Padding, height + Padding, sf::IntRect(0, h - 1, w, 1));
+    // the columns include the rows copied above, which fills the corners
+    padded.copy(padded, 0, 0, sf::IntRect(1, 0, 1, h + 2));
+    padded.copy(padded, width + Padding, 0, sf::IntRect(w, 0, 1, h + 2));
+    return padded;
+  }
+
+  std::uint32_t     size;
+  std::vector<Page> pages;
+};
+
+// One sprite submitted for the current frame. Lower layers are drawn first,
+// rotation is in degrees around origin, like sf::Sprite.
+struct SpriteDraw
+{
+  AtlasRegion  region;
+  sf::Vector2f position;
+  sf::Vector2f origin;
+  sf::Vector2f scale{ 1.F, 1.F };
+  float        rotation{ 0.F };
+  sf::Color    color{ sf::Color::White };
+  std::int16_t layer{ 0 };
+};
+
+struct SpriteBatchStats
+{
+  using clock = std::chrono::steady_clock;
+
+  std::size_t     sprites{ 0 };
+  std::size_t     drawCalls{ 0 };
+  std::size_t     vertices{ 0 };
+  clock::duration build{};
+};
+
+// Collects the sprites of a frame and draws them with one sf::VertexArray per
+// run of sprites sharing an atlas page. The draw list is sorted by layer, then
+// page, then submission order: layers always draw in order, but within a layer
+// sprites on different pages do not keep their relative submission order.
+class SpriteBatch
+{
+public:
+  explicit SpriteBatch(const TextureAtlas &textureAtlas) : atlas{ textureAtlas } {}
+
+  void submit(const SpriteDraw &sprite) { sprites.push_back(sprite); }
+
+  // draws and clears everything submitted since the last call
+  void draw(sf::RenderTarget &target, sf::RenderStates states = sf::RenderStates::Default)
+  {
+    const auto start = SpriteBatchStats::clock::now();
+
+    order.clear();
+    for (std::uint32_t index = 0; const auto &sprite : sprites) {
+      order.push_back(sortKey(sprite, index));
+      ++index;
+    }
+    std::sort(order.begin(), order.end());
+
+    statistics         = SpriteBatchStats{};
+    statistics.sprites = sprites.size();
+
+    // vertex arrays keep their capacity between frames, so a steady scene does not allocate
+    std::size_t run = 0;
+    for (std::size_t first = 0; first < order.size(); ++run) {
+      const auto page = pageOf(order[first]);
+      auto       last = first;
+      while (last < order.size() && pageOf(order[last]) == page) { ++last; }
+
+      if (run == buffers.size()) { buffers.emplace_back(sf::Triangles); }
+      auto &vertices = buffers[run];
+      vertices.resize((last - first) * VerticesPerSprite);
+      for (auto index = first; index < last; ++index) {
+        appendQuad(vertices, (index - first) * VerticesPerSprite, sprites[order[index] & IndexMask]);
+      }
+
+      states.texture = &atlas.texture(page);
+      target.draw(vertices, states);
+
+      ++statistics.drawCalls;
+      statistics.vertices += vertices.getVertexCount();
+      first = last;
+    }
+
+    sprites.clear();
+    statistics.build = SpriteBatchStats::clock::now() - start;
+  }
+
+  [[nodiscard]] std::size_t             pending() const noexcept { return sprites.size(); }
+  [[nodiscard]] const SpriteBatchStats &stats() const noexcept { return statistics; }
+
+private:
+  static constexpr std::size_t   VerticesPerSprite = 6;
+  static constexpr std::uint64_t IndexMask         = 0xFFFF'FFFF;
+
+  // layer:16 | page:16 | submission index:32
+  static std::uint64_t sortKey(const SpriteDraw &sprite, const std::uint32_t index) noexcept
+  {
+    constexpr auto lowest = std::int32_t{ std::numeric_limits<std::int16_t>::min() };
+    const auto     layer  = static_cast<std::uint16_t>(std::int32_t{ sprite.layer } - lowest);
+    return std::uint64_t{ layer } << 48U | std::uint64_t{ sprite.region.page } << 32U | index;
+  }
+
+  static std::uint16_t pageOf(const std::uint64_t key) noexcept { return static_cast<std::uint16_t>(key >> 32U); }
+
+  static void appendQuad(sf::VertexArray &vertices, const std::size_t first, const SpriteDraw &sprite)
+  {
+    const auto &rect   = sprite.region.rect;
+    const auto  left   = -sprite.origin.x * sprite.scale.x;
+    const auto  top    = -sprite.origin.y * sprite.scale.y;
+    const auto  right  = left + static_cast<float>(rect.width) * sprite.scale.x;
+    const auto  bottom = top + static_cast<float>(rect.height) * sprite.scale.y;
+
+    auto cosine = 1.F;
+    auto sine   = 0.F;
+    if (sprite.rotation != 0.F) {
+      const auto radians = sprite.rotation * std::numbers::pi_v<float> / 180.F;
+      cosine             = std::cos(radians);
+      sine               = std::sin(radians);
+    }
+
+    const auto corner = [&](const float x, const float y) {
+      return sf::Vector2f(sprite.position.x + x * cosine - y * sine, sprite.position.y + x * sine + y * cosine);
+    };
+
+    const auto u0 = static_cast<float>(rect.left);
+    const auto v0 = static_cast<float>(rect.top);
+    const auto u1 = static_cast<float>(rect.left + rect.width);
+    const auto v1 = static_cast<float>(rect.top + rect.height);
+
+    const sf::Vertex topLeft(corner(left, top), sprite.color, sf::Vector2f(u0, v0));
+    const sf::Vertex topRight(corner(right, top), sprite.color, sf::Vector2f(u1, v0));
+    const sf::Vertex bottomRight(corner(right, bottom), sprite.color, sf::Vector2f(u1, v1));
+    const sf::Vertex bottomLeft(corner(left, bottom), sprite.color, sf::Vector2f(u0, v1));
+
+    vertices[first]     = topLeft;
+    vertices[first + 1] = topRight;
+    vertices[first + 2] = bottomRight;
+    vertices[first + 3] = topLeft;
+    vertices[first + 4] = bottomRight;
+    vertices[first + 5] = bottomLeft;
+  }
+
+  const TextureAtlas &         atlas;
+  std::vector<SpriteDraw>      sprites;
+  std::vector<std::uint64_t>   order;
+  std::vector<sf::VertexArray> buffers;
+  SpriteBatchStats             statistics;
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_SPRITEBATCH_HPP
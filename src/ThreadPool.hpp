@@ -0,0 +1,160 @@
+#ifndef MYPROJECT_THREADPOOL_HPP
+#define MYPROJECT_THREADPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Game {
+
+class ThreadPool
+{
+public:
+  explicit ThreadPool(const std::size_t threadCount = defaultThreadCount())
+  {
+    workers.reserve(threadCount);
+    for (std::size_t index = 0; index < threadCount; ++index) {
+      workers.emplace_back([this](const std::stop_token &stop) { work(stop); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool(ThreadPool &&)      = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ThreadPool &operator=(ThreadPool &&) = delete;
+
+  ~ThreadPool()
+  {
+    for (auto &worker : workers) { worker.request_stop(); }
+    wakeup.notify_all();
+  }
+
+  [[nodiscard]] static std::size_t defaultThreadCount()
+  {
+    return std::max(std::thread::hardware_concurrency(), 2U) - 1;
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return workers.size(); }
+
+  template<typename Func> auto submit(Func &&func) -> std::future<std::invoke_result_t<std::decay_t<Func>>>
+  {
+    using Result = std::invoke_result_t<std::decay_t<Func>>;
+    auto task    = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+    auto result  = task->get_future();
+    enqueue([task]() { (*task)(); });
+    return result;
+  }
+
+  // Calls func(begin, end) over [0, count) in blocks of at most grain elements.
+  // The calling thread takes part in the work, so it is safe to call from inside
+  // a task that is itself running on the pool.
+  template<typename Func> void parallelFor(const std::size_t count, const std::size_t grain, Func &&func)
+  {
+    if (count == 0) { return; }
+
+    const auto blockSize  = std::max(grain, std::size_t{ 1 });
+    const auto blockCount = (count + blockSize - 1) / blockSize;
+
+    if (blockCount == 1 || workers.empty()) {
+      func(std::size_t{ 0 }, count);
+      return;
+    }
+
+    struct Shared
+    {
+      std::function<void(std::size_t, std::size_t)> body;
+      std::size_t                                   count;
+      std::size_t                                   blockSize;
+      std::size_t                                   blockCount;
+      std::atomic<std::size_t>                      next{ 0 };
+      std::atomic<std::size_t>                      completed{ 0 };
+      std::mutex                                    errorMutex;
+      std::exception_ptr                            error;
+
+      // returns false once every block has been claimed
+      bool runOne()
+      {
+        const auto block = next.fetch_add(1);
+        if (block >= blockCount) { return false; }
+
+        try {
+          const auto begin = block * blockSize;
+          body(begin, std::min(begin + blockSize, count));
+        } catch (...) {
+          std::scoped_lock lock(errorMutex);
+          if (!error) { error = std::current_exception(); }
+        }
+
+        if (completed.fetch_add(1) + 1 == blockCount) { completed.notify_all(); }
+        return true;
+      }
+    };
+
+    auto shared        = std::make_shared<Shared>();
+    shared->body       = [&func](std::size_t begin, std::size_t end) { func(begin, end); };
+    shared->count      = count;
+    shared->blockSize  = blockSize;
+    shared->blockCount = blockCount;
+
+    // helpers that start after all blocks are claimed never touch func
+    const auto helpers = std::min(workers.size(), blockCount - 1);
+    for (std::size_t index = 0; index < helpers; ++index) {
+      enqueue([shared]() {
+        while (shared->runOne()) {}
+      });
+    }
+
+    while (shared->runOne()) {}
+
+    for (auto done = shared->completed.load(); done != blockCount; done = shared->completed.load()) {
+      shared->completed.wait(done);
+    }
+
+    if (shared->error) { std::rethrow_exception(shared->error); }
+  }
+
+private:
+  void enqueue(std::function<void()> task)
+  {
+    {
+      std::scoped_lock lock(mutex);
+      tasks.push_back(std::move(task));
+    }
+    wakeup.notify_one();
+  }
+
+  void work(const std::stop_token &stop)
+  {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock(mutex);
+        if (!wakeup.wait(lock, stop, [this]() { return !tasks.empty(); })) { return; }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex                        mutex;
+  std::condition_variable_any       wakeup;
+  std::deque<std::function<void()>> tasks;
+
+  // declared last so the workers are joined before the queue is destroyed
+  std::vector<std::jthread> workers;
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_THREADPOOL_HPP
@@ -0,0 +1,58 @@
+#ifndef MYPROJECT_UDPTRANSPORT_HPP
+#define MYPROJECT_UDPTRANSPORT_HPP
+
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Rollback.hpp"
+
+namespace Game {
+
+// Non blocking UDP socket that only talks to a single peer.
+class UdpTransport : public Transport
+{
+public:
+  UdpTransport(const unsigned short localPort, const sf::IpAddress &remoteAddress, const unsigned short remotePort)
+    : peerAddress{ remoteAddress }, peerPort{ remotePort }
+  {
+    if (socket.bind(localPort) != sf::Socket::Done) {
+      throw std::runtime_error("unable to bind UDP port " + std::to_string(localPort));
+    }
+    socket.setBlocking(false);
+  }
+
+  void send(std::span<const std::uint8_t> datagram) override
+  {
+    // a full send buffer is just another lost packet
+    static_cast<void>(socket.send(datagram.data(), datagram.size(), peerAddress, peerPort));
+  }
+
+  std::optional<std::vector<std::uint8_t>> receive() override
+  {
+    std::size_t    received = 0;
+    sf::IpAddress  sender;
+    unsigned short senderPort = 0;
+
+    while (socket.receive(buffer.data(), buffer.size(), received, sender, senderPort) == sf::Socket::Done) {
+      if (sender == peerAddress && senderPort == peerPort) {
+        return std::vector<std::uint8_t>(
+          buffer.begin(), std::next(buffer.begin(), static_cast<std::ptrdiff_t>(received)));
+      }
+    }
+    return {};
+  }
+
+private:
+  sf::UdpSocket             socket;
+  sf::IpAddress             peerAddress;
+  unsigned short            peerPort;
+  std::vector<std::uint8_t> buffer = std::vector<std::uint8_t>(sf::UdpSocket::MaxDatagramSize);
+};
+
+}// namespace Game
+
+#endif// MYPROJECT_UDPTRANSPORT_HPP
@@ -13,8 +13,13 @@
 #include <docopt/docopt.h>
 #include <nlohmann/json.hpp>
 
-#include "ImGuiHelpers.hpp"
+#include "AllocationTracker.hpp"
+#include "Assets.hpp"
+#include "GameLoop.hpp"
 #include "Input.hpp"
+#include "Rollback.hpp"
+#include "ThreadPool.hpp"
+#include "UdpTransport.hpp"
 #include "Utility.hpp"
 
 
@@ -29,11 +34,22 @@ static constexpr auto USAGE =
           --height=HEIGHT     Screen height in pixels [default: 768].
           --scale=SCALE       Scaling factor [default: 2].
           --replay=EVENTFILE  JSON file of events to play.
+          --latency-log=FILE  Dump input latency histograms to FILE on exit.
+          --asset-cache=DIR   Directory for pre-processed assets.
+          --listen=PORT       Local UDP port for netplay.
+          --peer=ADDRESS      Netplay peer as host:port, enables rollback netplay.
+          --player=N          Netplay player slot, 0 or 1 [default: 0].
+          --sim-latency=MS    Simulated one way netplay latency [default: 0].
+          --sim-jitter=MS     Simulated netplay latency jitter [default: 0].
+          --sim-loss=PERCENT  Simulated netplay packet loss [default: 0].
+          --sprite-stress=N   Sprites in the sprite batching stress scene [default: 0].
 )";
 
 
 int main(int argc, const char **argv)
 {
+  const auto startTime = Game::AssetManager::clock::now();
+
   std::map<std::string, docopt::value> args = docopt::docopt(USAGE,
                                                              { std::next(argv), std::next(argv, argc) },
                                                              true,// show help if requested
@@ -43,13 +59,18 @@ int main(int argc, const char **argv)
   const auto height = args["--height"].asLong();
   const auto scale  = args["--scale"].asLong();
 
-  std::vector<Game::GameState::Event> initialEvents;
-  if (args["--replay"]) {
-    const auto     eventFile = args["--replay"].asString();
-    std::ifstream  ifs(eventFile);
-    const auto j = nlohmann::json::parse(ifs);
-    initialEvents = j.get<std::vector<Game::GameState::Event>>();
-  }
+  std::optional<std::filesystem::path> latencyLog;
+  if (args["--latency-log"]) { latencyLog = args["--latency-log"].asString(); }
+
+  Game::ThreadPool pool;
+
+  std::optional<std::filesystem::path> assetCache;
+  if (args["--asset-cache"]) { assetCache = args["--asset-cache"].asString(); }
+  Game::AssetManager assets{ pool, assetCache };
+
+  // decoded while the window and ImGui are being set up
+  Game::Asset<std::vector<Game::GameState::Event>> replay;
+  if (args["--replay"]) { replay = assets.load<std::vector<Game::GameState::Event>>(args["--replay"].asString()); }
 
 
   if (width < 0 || height < 0 || scale < 1 || scale > 5) {
@@ -69,122 +90,85 @@ int main(int argc, const char **argv)
   sf::RenderWindow window(sf::VideoMode(static_cast<unsigned int>(width), static_cast<unsigned int>(height)),
                           "ImGui + SFML = <3");
   window.setFramerateLimit(60);
+#ifdef GAME_TRACK_ALLOCATIONS
+  // must happen before the ImGui context exists
+  ImGui::SetAllocatorFunctions(Game::Allocations::countedMalloc, Game::Allocations::countedFree);
+#endif
   ImGui::SFML::Init(window);
 
   const auto scale_factor = static_cast<float>(scale);
   ImGui::GetStyle().ScaleAllSizes(scale_factor);
   ImGui::GetIO().FontGlobalScale = scale_factor;
 
-  constexpr std::array steps = { "The Plan",
-                                 "Getting Started",
-                                 "Finding Errors As Soon As Possible",
-                                 "Handling Command Line Parameters",
-                                 "Reading SFML Joystick States",
-                                 "Displaying Joystick States",
-                                 "Dealing With Game Events",
-                                 "Reading SFML Keyboard States",
-                                 "Reading SFML Mouse States",
-                                 "Reading SFML Touchscreen States",
-                                 "C++ 20 So Far",
-                                 "Managing Game State",
-                                 "Making Our Game Testable",
-                                 "Making Game State Allocator Aware",
-                                 "Add Logging To Game Engine",
-                                 "Draw A Game Map",
-                                 "Dialog Trees",
-                                 "Porting From SFML To SDL" };
-
-  std::array<bool, steps.size()> states{};
-
   Game::GameState gs;
-  gs.setEvents(initialEvents);
+  if (args["--replay"]) { gs.setEvents(assets.wait(replay)); }
 
-  bool            joystickEvent = false;
+  Game::GameLoop loop{
+    gs, pool, assets, { static_cast<float>(width), static_cast<float>(height) }, latencyLog, startTime
+  };
 
-  std::uint64_t eventsProcessed{ 0 };
+  std::unique_ptr<Game::UdpTransport>     netplaySocket;
+  std::unique_ptr<Game::SimulatedNetwork> netplayLink;
 
-  std::vector<Game::GameState::Event> events{ Game::GameState::TimeElapsed{} };
+  if (args["--peer"]) {
+    const auto peer  = args["--peer"].asString();
+    const auto colon = peer.rfind(':');
+    if (colon == std::string::npos || !args["--listen"]) {
+      spdlog::error("--peer expects host:port and requires --listen");
+      abort();
+    }
 
-  while (window.isOpen()) {
+    netplaySocket = std::make_unique<Game::UdpTransport>(static_cast<unsigned short>(args["--listen"].asLong()),
+      sf::IpAddress{ peer.substr(0, colon) },
+      static_cast<unsigned short>(std::stoi(peer.substr(colon + 1))));
 
-    const auto event = gs.nextEvent(window);
+    netplayLink = std::make_unique<Game::SimulatedNetwork>(*netplaySocket,
+      Game::SimulatedNetwork::Conditions{ std::chrono::milliseconds{ args["--sim-latency"].asLong() },
+        std::chrono::milliseconds{ args["--sim-jitter"].asLong() },
+        static_cast<double>(args["--sim-loss"].asLong()) / 100.0 });
 
-    std::visit(Game::overloaded{ [](Game::GameState::TimeElapsed &prev, const Game::GameState::TimeElapsed &next) {
-                                  prev.elapsed += next.elapsed;
-                                },
-                                 [&](const auto & /*prev*/, const std::monostate &) {},
-                                 [&](const auto & /*prev*/, const auto &next) { events.push_back(next); } },
-               events.back(),
-               event);
+    loop.startNetplay(*netplayLink, static_cast<std::size_t>(args["--player"].asLong()));
+  }
+
+  if (const auto count = args["--sprite-stress"].asLong(); count > 0) {
+    loop.spawnStressSprites(static_cast<std::size_t>(count));
+  }
 
-    ++eventsProcessed;
+  while (window.isOpen()) {
+
+    const auto event = gs.nextEvent(window);
 
     if (const auto sfmlEvent = Game::GameState::toSFMLEvent(event); sfmlEvent) {
       ImGui::SFML::ProcessEvent(*sfmlEvent);
     }
 
+    const auto elapsed = loop.handle(event);
+    if (loop.closeRequested()) { window.close(); }
 
-    bool timeElapsed = false;
-
-    std::visit(Game::overloaded{ [&](const Game::JoystickEvent auto &jsEvent) {
-                                  gs.update(jsEvent);
-                                  joystickEvent = true;
-                                },
-                                 [&](const Game::GameState::CloseWindow & /*unused*/) { window.close(); },
-                                 [&](const Game::GameState::TimeElapsed &te) {
-                                   ImGui::SFML::Update(window, te.toSFMLTime());
-                                   timeElapsed = true;
-                                 },
-                                 [&](const std::monostate & /*unused*/) {
-
-                                 },
-                                 [&](const auto & /*do nothing*/) {}
-
-               },
-               event);
-
-
-    if (!timeElapsed) {
+    if (!elapsed) {
       // todo: something more with a linear flow here
       // right now this is just saying "no reason to update the render yet"
       continue;
     }
 
-
-    ImGui::Begin("The Plan");
-
-    for (std::size_t index = 0; const auto &step : steps) {
-      ImGui::Checkbox(fmt::format("{} : {}", index, step).c_str(), &states.at(index));
-      ++index;
-    }
-
-    ImGui::End();
-
-    ImGui::Begin("Joystick");
-
-    if (!gs.joySticks.empty()) {
-      ImGuiHelper::Text("Joystick Event: {}", joystickEvent);
-      joystickEvent = false;
-      for (std::size_t button = 0; button < gs.joySticks[0].buttonCount; ++button) {
-        ImGuiHelper::Text("{}: {}", button, gs.joySticks[0].buttonState[button]);
-      }
-
-      for (std::size_t axis = 0; axis < sf::Joystick::AxisCount; ++axis) {
-        ImGuiHelper::Text(
-          "{}: {}", Game::toString(static_cast<sf::Joystick::Axis>(axis)), gs.joySticks[0].axisPosition[axis]);
-      }
-    }
-
-    ImGui::End();
+    ImGui::SFML::Update(window, *elapsed);
+    loop.frame(*elapsed);
 
     window.clear();
+    loop.sprites().draw(window);
     ImGui::SFML::Render(window);
     window.display();
+
+    if (loop.presented()) {
+      spdlog::info("Time to first frame: {}ms",
+        std::chrono::duration_cast<std::chrono::milliseconds>(*loop.timeToFirstFrame()).count());
+    }
   }
 
   ImGui::SFML::Shutdown();
 
-  spdlog::info("Total events processed: {}, total recorded {}", eventsProcessed, events.size());
+  const auto &events = loop.recorded();
+  spdlog::info("Total events processed: {}, total recorded {}", loop.processed(), events.size());
 
   for (const auto &event : events) {
     std::visit(Game::overloaded{ [](const auto &event_obj) { spdlog::info("Event: {}", event_obj.name); },
@@ -192,6 +176,8 @@ int main(int argc, const char **argv)
                event);
   }
 
+  loop.dumpLatency();
+
   nlohmann::json serialized( events );
   std::ofstream ofs{ "events.json" };
   ofs << serialized;
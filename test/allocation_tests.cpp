@@ -0,0 +1,214 @@
+#include <catch2/catch.hpp>
+
+#include <SFML/Window/Event.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <imgui.h>
+#include <nlohmann/json.hpp>
+
+#include "AllocationTracker.hpp"
+#include "Assets.hpp"
+#include "GameLoop.hpp"
+#include "Input.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+
+using Event = Game::GameState::Event;
+
+constexpr std::size_t WarmupFrames   = 120;
+constexpr std::size_t MeasuredFrames = 600;
+
+// A frame of play: the mouse sweeps across the map, clicks now and then and a
+// key is tapped; every frame ends with the TimeElapsed that triggers rendering.
+// nextEvent sleeps for each TimeElapsed, so frames are kept short.
+std::vector<Event> scriptedEvents(const std::size_t frames)
+{
+  std::vector<Event> script;
+  for (std::size_t frame = 0; frame < frames; ++frame) {
+    const Game::GameState::Mouse mouse{ static_cast<int>(frame * 7 % 1024), static_cast<int>(frame * 3 % 768) };
+    script.emplace_back(Game::GameState::Moved<Game::GameState::Mouse>{ mouse });
+    if (frame % 30 == 0) {
+      script.emplace_back(Game::GameState::Pressed<Game::GameState::MouseButton>{ { 0, mouse } });
+      script.emplace_back(Game::GameState::Released<Game::GameState::MouseButton>{ { 0, mouse } });
+    }
+    if (frame % 45 == 0) {
+      const Game::GameState::Key key{ false, false, false, false, sf::Keyboard::Space };
+      script.emplace_back(Game::GameState::Pressed<Game::GameState::Key>{ key });
+      script.emplace_back(Game::GameState::Released<Game::GameState::Key>{ key });
+    }
+    script.emplace_back(Game::GameState::TimeElapsed{ std::chrono::milliseconds{ 1 } });
+  }
+  return script;
+}
+
+// stands in for the window, so only the replayed events come through nextEvent
+struct HeadlessWindow
+{
+  static bool pollEvent(sf::Event & /*event*/) { return false; }
+};
+
+// The part of ImGui::SFML::ProcessEvent the script exercises; the real one
+// needs a window to have been passed to ImGui::SFML::Init.
+void feedImGui(const sf::Event &event)
+{
+  auto &io = ImGui::GetIO();
+  switch (event.type) {
+  case sf::Event::MouseMoved:
+    io.MousePos = ImVec2{ static_cast<float>(event.mouseMove.x), static_cast<float>(event.mouseMove.y) };
+    break;
+  case sf::Event::MouseButtonPressed:
+  case sf::Event::MouseButtonReleased:
+    io.MouseDown[event.mouseButton.button] = event.type == sf::Event::MouseButtonPressed;
+    break;
+  case sf::Event::KeyPressed:
+  case sf::Event::KeyReleased:
+    if (event.key.code >= 0) { io.KeysDown[event.key.code] = event.type == sf::Event::KeyPressed; }
+    break;
+  default:
+    break;
+  }
+}
+
+// main.cpp's loop without the window: the same nextEvent and Game::GameLoop,
+// with ImGui fed by hand instead of through ImGui-SFML and nothing drawn.
+// ImGui allocates through the tracker like it does in the game. Returns the
+// allocation counters of each frame.
+class FrameDriver
+{
+public:
+  FrameDriver()
+  {
+    // the allocator has to be in place before the context allocates anything
+    ImGui::SetAllocatorFunctions(Game::Allocations::countedMalloc, Game::Allocations::countedFree);
+    ImGui::CreateContext();
+    auto &io       = ImGui::GetIO();
+    io.DisplaySize = ImVec2{ 1024, 768 };
+
+    unsigned char *pixels = nullptr;
+    int            width  = 0;
+    int            height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+  }
+
+  FrameDriver(const FrameDriver &) = delete;
+  FrameDriver(FrameDriver &&)      = delete;
+  FrameDriver &operator=(const FrameDriver &) = delete;
+  FrameDriver &operator=(FrameDriver &&) = delete;
+
+  ~FrameDriver() { ImGui::DestroyContext(); }
+
+  std::vector<Game::Allocations::Counters> run(std::vector<Event> script)
+  {
+    std::vector<Game::Allocations::Counters> frames;
+    frames.reserve(WarmupFrames + MeasuredFrames);
+
+    gs.setEvents(std::move(script));
+    HeadlessWindow window;
+
+    Game::Allocations::endFrame();
+    while (!gs.pendingEvents.empty()) {
+      const auto event = gs.nextEvent(window);
+
+      if (const auto sfmlEvent = Game::GameState::toSFMLEvent(event); sfmlEvent) { feedImGui(*sfmlEvent); }
+
+      const auto elapsed = loop.handle(event);
+      if (!elapsed) { continue; }
+
+      ImGui::GetIO().DeltaTime = elapsed->asSeconds();
+      ImGui::NewFrame();
+      loop.frame(*elapsed);
+      ImGui::Render();
+
+      loop.presented();
+      frames.push_back(loop.frameAllocations());
+    }
+    return frames;
+  }
+
+private:
+  Game::GameState    gs;
+  Game::ThreadPool   pool{ 1 };
+  Game::AssetManager assets{ pool };
+  Game::GameLoop     loop{ gs, pool, assets, { 1024.F, 768.F }, std::nullopt };
+};
+
+}// namespace
+
+#if defined(_MSC_VER)
+#define TEST_NOINLINE __declspec(noinline)
+#else
+#define TEST_NOINLINE [[gnu::noinline]]
+#endif
+
+// A call site with a known name: out of line, with external linkage so the
+// exported executable has it in its dynamic symbol table, and calling
+// operator new itself rather than through an allocator template.
+TEST_NOINLINE std::unique_ptr<int> allocateTrackedInt(const int value)
+{
+  return std::unique_ptr<int>(new int{ value });// NOLINT(cppcoreguidelines-owning-memory)
+}
+
+TEST_CASE("Main loop allocations stay within budget in steady state", "[allocations]")
+{
+  // Recording the event stream is the only expected steady state allocation,
+  // and its amortized growth reallocates at most once in a frame.
+  constexpr std::uint64_t FrameBudget = 1;
+
+  FrameDriver driver;
+  const auto  frames = driver.run(scriptedEvents(WarmupFrames + MeasuredFrames));
+  REQUIRE(frames.size() == WarmupFrames + MeasuredFrames);
+
+  std::uint64_t total = 0;
+  std::uint64_t worst = 0;
+  for (std::size_t frame = WarmupFrames; frame < frames.size(); ++frame) {
+    total += frames[frame].allocations;
+    worst = std::max(worst, frames[frame].allocations);
+  }
+
+  INFO("steady state allocations: " << total << " over " << MeasuredFrames << " frames, worst frame " << worst);
+  CHECK(worst <= FrameBudget);
+  CHECK(total <= MeasuredFrames / 16);
+}
+
+TEST_CASE("Allocation tracker counts call sites", "[allocations]")
+{
+  const auto before = Game::Allocations::total();
+
+  std::vector<std::unique_ptr<int>> values;
+  values.reserve(64);
+  for (int value = 0; value < 64; ++value) { values.push_back(allocateTrackedInt(value)); }
+  values.clear();
+
+  const auto after = Game::Allocations::total();
+  CHECK(after.allocations - before.allocations >= 65);
+  CHECK(after.deallocations - before.deallocations >= 64);
+  CHECK(after.bytes - before.bytes >= 64 * sizeof(int));
+
+  std::array<Game::Allocations::Site, 64> sites{};
+  const auto                              found = Game::Allocations::topSites(sites);
+  REQUIRE(found > 0);
+  for (std::size_t index = 1; index < found; ++index) {
+    CHECK(sites[index - 1].allocations >= sites[index].allocations);
+  }
+
+#if __has_include(<dlfcn.h>)
+  // the earlier test leaves busier sites behind, so look for the helper among them
+  const auto helper = std::find_if(sites.begin(), std::next(sites.begin(), static_cast<std::ptrdiff_t>(found)),
+    [](const Game::Allocations::Site &site) {
+      return Game::Allocations::describe(site.address).find("allocateTrackedInt") != std::string::npos;
+    });
+  REQUIRE(helper != std::next(sites.begin(), static_cast<std::ptrdiff_t>(found)));
+  CHECK(helper->allocations >= 64);
+#else
+  CHECK(sites[0].allocations >= 64);
+  CHECK_FALSE(Game::Allocations::describe(sites[0].address).empty());
+#endif
+}
@@ -0,0 +1,229 @@
+#include <catch2/catch.hpp>
+
+#include "ECS.hpp"
+#include "Pathfinding.hpp"
+
+#include <random>
+
+namespace {
+struct Position
+{
+  float x;
+  float y;
+};
+
+struct Velocity
+{
+  float dx;
+  float dy;
+};
+
+struct Health
+{
+  int value;
+};
+
+constexpr std::size_t EntityCount = 100000;
+constexpr int         MapSize     = 1024;
+constexpr std::size_t AgentCount  = 1000;
+
+Game::ECS::World makeWorld()
+{
+  Game::ECS::World world;
+  for (std::size_t index = 0; index < EntityCount; ++index) {
+    const auto value = static_cast<float>(index);
+    if (index % 2 == 0) {
+      world.create(Position{ value, value }, Velocity{ 1.0F, -1.0F });
+    } else {
+      world.create(Position{ value, value }, Velocity{ 1.0F, -1.0F }, Health{ 100 });
+    }
+  }
+  return world;
+}
+
+// open terrain with scattered rocks, patches of rough ground and long walls with gaps
+Game::TileGrid makeMap()
+{
+  Game::TileGrid                     grid{ MapSize, MapSize };
+  std::mt19937                       rng{ 42 };
+  std::uniform_int_distribution<int> percent{ 0, 99 };
+  for (int y = 0; y < MapSize; ++y) {
+    for (int x = 0; x < MapSize; ++x) {
+      const bool wall = (x % 97 == 0 && y % 41 > 4) || (y % 89 == 0 && x % 53 > 4);
+      if (wall || percent(rng) < 5) {
+        grid.setCost({ x, y }, Game::TileGrid::Blocked);
+      } else if ((x / 24 + y / 40) % 4 == 0) {
+        grid.setCost({ x, y }, 3);
+      }
+    }
+  }
+  return grid;
+}
+
+std::vector<Game::PathService::Request> makeAgents(const Game::TileGrid &grid)
+{
+  std::mt19937                            rng{ 1 };
+  std::uniform_int_distribution<int>      coordinate{ 0, MapSize - 1 };
+  std::vector<Game::PathService::Request> agents;
+  const auto                              randomTile = [&] {
+    while (true) {
+      const Game::GridPoint point{ coordinate(rng), coordinate(rng) };
+      if (grid.passable(point)) { return point; }
+    }
+  };
+  while (agents.size() < AgentCount) { agents.push_back({ randomTile(), randomTile() }); }
+  return agents;
+}
+}// namespace
+
+TEST_CASE("ECS iteration over 100k entities", "[!benchmark][ecs]")
+{
+  auto             world = makeWorld();
+  Game::ThreadPool pool;
+
+  BENCHMARK("each<Position, const Velocity>")
+  {
+    world.each<Position, const Velocity>([](Position &pos, const Velocity &vel) {
+      pos.x += vel.dx;
+      pos.y += vel.dy;
+    });
+    return world.size();
+  };
+
+  BENCHMARK("eachChunk<Position, const Velocity>")
+  {
+    world.eachChunk<Position, const Velocity>(
+      [](const std::size_t count, const Game::ECS::Entity *, Position *pos, const Velocity *vel) {
+        for (std::size_t row = 0; row < count; ++row) {
+          pos[row].x += vel[row].dx;
+          pos[row].y += vel[row].dy;
+        }
+      });
+    return world.size();
+  };
+
+  BENCHMARK("parallelEach<Position, const Velocity>")
+  {
+    world.parallelEach<Position, const Velocity>(pool, [](Position &pos, const Velocity &vel) {
+      pos.x += vel.dx;
+      pos.y += vel.dy;
+    });
+    return world.size();
+  };
+
+  Game::ECS::Scheduler scheduler;
+  scheduler.add("move", Game::ECS::Access{}.read<Velocity>().write<Position>(), [](Game::ECS::World &w) {
+    w.each<Position, const Velocity>([](Position &pos, const Velocity &vel) {
+      pos.x += vel.dx;
+      pos.y += vel.dy;
+    });
+  });
+  scheduler.add("regenerate", Game::ECS::Access{}.write<Health>(), [](Game::ECS::World &w) {
+    w.each<Health>([](Health &health) { health.value = std::min(health.value + 1, 100); });
+  });
+
+  BENCHMARK("Scheduler::run with two independent systems") { scheduler.run(world, pool); };
+}
+
+TEST_CASE("ECS mutation of 100k entities", "[!benchmark][ecs]")
+{
+  BENCHMARK("create 100k entities") { return makeWorld().size(); };
+
+  BENCHMARK_ADVANCED("add and remove a component on 100k entities")(Catch::Benchmark::Chronometer meter)
+  {
+    auto                           world = makeWorld();
+    std::vector<Game::ECS::Entity> entities;
+    world.each<const Position>([&](const Game::ECS::Entity entity, const Position &) { entities.push_back(entity); });
+
+    meter.measure([&] {
+      for (const auto entity : entities) { world.add(entity, Health{ 50 }); }
+      for (const auto entity : entities) { world.remove<Health>(entity); }
+      return world.size();
+    });
+  };
+
+  BENCHMARK_ADVANCED("destroy 100k entities")(Catch::Benchmark::Chronometer meter)
+  {
+    auto                           world = makeWorld();
+    std::vector<Game::ECS::Entity> entities;
+    world.each<const Position>([&](const Game::ECS::Entity entity, const Position &) { entities.push_back(entity); });
+
+    // one copy per run, made up front so only the destruction is timed
+    std::vector<Game::ECS::World> copies(static_cast<std::size_t>(meter.runs()), world);
+
+    meter.measure([&](const int run) {
+      auto &copy = copies[static_cast<std::size_t>(run)];
+      for (const auto entity : entities) { copy.destroy(entity); }
+      return copy.size();
+    });
+  };
+}
+
+TEST_CASE("Pathfinding for 1000 agents on a 1024x1024 map", "[!benchmark][pathfinding]")
+{
+  const auto       map    = makeMap();
+  const auto       agents = makeAgents(map);
+  Game::ThreadPool pool;
+
+  BENCHMARK("precompute clusters")
+  {
+    Game::PathService service{ map };
+    service.prepare(&pool);
+    return service.nodeCount();
+  };
+
+  Game::PathService service{ map };
+  service.prepare(&pool);
+  std::vector<Game::PathService::PathHandle> paths(agents.size());
+
+  BENCHMARK("1000 agents, batched, cold cache")
+  {
+    service.clearCache();
+    service.findBatch(agents, paths, pool);
+    return paths.size();
+  };
+
+  BENCHMARK("1000 agents, one at a time, cold cache")
+  {
+    service.clearCache();
+    for (std::size_t agent = 0; agent < agents.size(); ++agent) {
+      paths[agent] = service.find(agents[agent].start, agents[agent].goal);
+    }
+    return paths.size();
+  };
+
+  BENCHMARK("1000 agents, batched, warm cache")
+  {
+    service.findBatch(agents, paths, pool);
+    return paths.size();
+  };
+
+  BENCHMARK_ADVANCED("1000 agents, batched, one tile changes per frame")(Catch::Benchmark::Chronometer meter)
+  {
+    std::mt19937                       rng{ 3 };
+    std::uniform_int_distribution<int> coordinate{ 0, MapSize - 1 };
+    service.findBatch(agents, paths, pool);
+
+    meter.measure([&] {
+      const Game::GridPoint tile{ coordinate(rng), coordinate(rng) };
+      service.setCost(tile, service.grid().passable(tile) ? Game::TileGrid::Blocked : 1);
+      service.findBatch(agents, paths, pool);
+      return paths.size();
+    });
+  };
+
+  // the flat search without clusters, for comparison, on a tenth of the agents
+  BENCHMARK_ADVANCED("100 agents, exact A* over the whole map")(Catch::Benchmark::Chronometer meter)
+  {
+    Game::GridSearch        search;
+    Game::PathService::Path path;
+    meter.measure([&] {
+      std::size_t found = 0;
+      for (std::size_t agent = 0; agent < agents.size() / 10; ++agent) {
+        path.clear();
+        if (search.findPath(map, agents[agent].start, agents[agent].goal, map.bounds(), path)) { ++found; }
+      }
+      return found;
+    });
+  };
+}
@@ -1,5 +1,20 @@
 #include <catch2/catch.hpp>
 
+#include "Assets.hpp"
+#include "ECS.hpp"
+#include "Latency.hpp"
+#include "Pathfinding.hpp"
+#include "Rollback.hpp"
+#include "ShelfPacker.hpp"
+#include "Simulation.hpp"
+#include "SpatialHash.hpp"
+#include "UdpTransport.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+
 unsigned int Factorial(unsigned int number)
 {
   return number <= 1 ? number : Factorial(number - 1) * number;
@@ -12,3 +27,887 @@ TEST_CASE("Factorials are computed", "[factorial]")
   REQUIRE(Factorial(3) == 6);
   REQUIRE(Factorial(10) == 3628800);
 }
+
+TEST_CASE("Latency histogram buckets are continuous", "[latency]")
+{
+  using Game::LatencyHistogram;
+  for (std::size_t index = 1; index < LatencyHistogram::BucketCount; ++index) {
+    REQUIRE(LatencyHistogram::bucketIndex(LatencyHistogram::bucketValue(index - 1) + 1) == index);
+  }
+  REQUIRE(LatencyHistogram::bucketIndex(LatencyHistogram::MaxValue) == LatencyHistogram::BucketCount - 1);
+}
+
+TEST_CASE("Latency percentiles are reported per input source", "[latency]")
+{
+  Game::LatencyTracker tracker;
+  const auto           start = Game::LatencyTracker::clock::now();
+
+  for (int frame = 1; frame <= 100; ++frame) {
+    tracker.polled(Game::InputSource::Key, start);
+    tracker.presented(start + std::chrono::milliseconds{ frame });
+  }
+
+  const auto &keys = tracker.histogram(Game::InputSource::Key);
+  REQUIRE(keys.count == 100);
+  REQUIRE(tracker.histogram(Game::InputSource::Mouse).count == 0);
+  REQUIRE(keys.max == 100000);
+  REQUIRE(keys.percentile(0.50) >= 50000);
+  REQUIRE(keys.percentile(0.50) <= 53125);
+  REQUIRE(keys.percentile(0.99) >= 99000);
+}
+
+namespace {
+struct Position
+{
+  float x;
+  float y;
+};
+
+struct Velocity
+{
+  float dx;
+  float dy;
+};
+
+struct Name
+{
+  std::string value;
+};
+
+// counts live instances, copying throws once copiesLeft runs out
+struct Fragile
+{
+  static inline int live       = 0;
+  static inline int copiesLeft = 0;
+
+  Fragile() { ++live; }
+  Fragile(const Fragile & /*other*/)
+  {
+    if (copiesLeft-- == 0) { throw std::runtime_error("copy failed"); }
+    ++live;
+  }
+  Fragile(Fragile && /*other*/) noexcept { ++live; }
+  Fragile &operator=(const Fragile &) = default;
+  Fragile &operator=(Fragile &&) = default;
+  ~Fragile() { --live; }
+};
+}// namespace
+
+TEST_CASE("Entity handles stay valid while other entities come and go", "[ecs]")
+{
+  Game::ECS::World world;
+
+  std::vector<Game::ECS::Entity> entities;
+  for (int index = 0; index < 5000; ++index) {
+    entities.push_back(world.create(Position{ static_cast<float>(index), 0.0F }));
+  }
+
+  for (std::size_t index = 0; index < entities.size(); index += 2) { world.destroy(entities[index]); }
+
+  REQUIRE(world.size() == 2500);
+  REQUIRE_FALSE(world.alive(entities[0]));
+  REQUIRE(world.get<Position>(entities[0]) == nullptr);
+
+  for (std::size_t index = 1; index < entities.size(); index += 2) {
+    REQUIRE(world.get<Position>(entities[index])->x == static_cast<float>(index));
+  }
+
+  const auto reused = world.create(Position{ -1.0F, 0.0F });
+  REQUIRE(reused.index == entities[4998].index);
+  REQUIRE_FALSE(world.alive(entities[4998]));
+}
+
+TEST_CASE("Adding and removing components moves entities between archetypes", "[ecs]")
+{
+  Game::ECS::World world;
+
+  const auto entity = world.create(Position{ 1.0F, 2.0F }, Name{ "npc" });
+  const auto other  = world.create(Position{ 3.0F, 4.0F }, Name{ "item" });
+
+  world.add(entity, Velocity{ 5.0F, 6.0F });
+  REQUIRE(world.archetypeCount() == 2);
+  REQUIRE(world.get<Position>(entity)->y == 2.0F);
+  REQUIRE(world.get<Name>(entity)->value == "npc");
+  REQUIRE(world.get<Velocity>(entity)->dx == 5.0F);
+  REQUIRE(world.get<Name>(other)->value == "item");
+
+  world.remove<Name>(entity);
+  REQUIRE_FALSE(world.has<Name>(entity));
+  REQUIRE(world.get<Velocity>(entity)->dy == 6.0F);
+
+  std::size_t moving = 0;
+  world.each<Position, const Velocity>([&](Position &pos, const Velocity &vel) {
+    pos.x += vel.dx;
+    ++moving;
+  });
+  REQUIRE(moving == 1);
+  REQUIRE(world.get<Position>(entity)->x == 6.0F);
+
+  auto copy = world;
+  world.get<Position>(entity)->x = 0.0F;
+  REQUIRE(copy.get<Position>(entity)->x == 6.0F);
+  REQUIRE(copy.get<Name>(other)->value == "item");
+}
+
+TEST_CASE("A world copy that throws releases everything it copied", "[ecs]")
+{
+  {
+    Game::ECS::World world;
+    for (int index = 0; index < 2000; ++index) { world.create(Fragile{}, Name{ "npc" }); }
+    REQUIRE(Fragile::live == 2000);
+
+    // fails part way through a later chunk, after whole chunks were copied
+    Fragile::copiesLeft = 1500;
+    REQUIRE_THROWS_AS(Game::ECS::World{ world }, std::runtime_error);
+    REQUIRE(Fragile::live == 2000);
+  }
+  REQUIRE(Fragile::live == 0);
+}
+
+TEST_CASE("Systems without conflicting access share a stage", "[ecs]")
+{
+  Game::ECS::Scheduler scheduler;
+  scheduler.add("move", Game::ECS::Access{}.read<Velocity>().write<Position>(), [](auto &) {});
+  scheduler.add("names", Game::ECS::Access{}.write<Name>(), [](auto &) {});
+  scheduler.add("render", Game::ECS::Access{}.read<Position, Name>(), [](auto &) {});
+  scheduler.add("spawn", Game::ECS::Access{}.structural(), [](auto &) {});
+
+  const auto &stages = scheduler.stageList();
+  REQUIRE(stages.size() == 3);
+  REQUIRE(stages[0].size() == 2);
+  REQUIRE(stages[1].size() == 1);
+  REQUIRE(stages[2].size() == 1);
+
+  Game::ThreadPool pool{ 2 };
+  Game::ECS::World world;
+  for (int index = 0; index < 10000; ++index) { world.create(Position{ 0.0F, 0.0F }, Velocity{ 1.0F, 2.0F }); }
+
+  world.parallelEach<Position, const Velocity>(pool, [](Position &pos, const Velocity &vel) {
+    pos.x += vel.dx;
+    pos.y += vel.dy;
+  });
+
+  float total = 0.0F;
+  world.each<const Position>([&](const Position &pos) { total += pos.y; });
+  REQUIRE(total == 20000.0F);
+}
+
+TEST_CASE("Scheduled systems see the writes of earlier stages", "[ecs]")
+{
+  using Game::ECS::Access;
+  using Game::ECS::World;
+
+  World world;
+  for (int index = 0; index < 1000; ++index) {
+    world.create(Position{ 0.0F, 0.0F }, Velocity{ 1.0F, 2.0F }, Name{ "npc" });
+  }
+
+  float       total   = 0.0F;
+  std::size_t renamed = 0;
+
+  Game::ECS::Scheduler scheduler;
+  scheduler.add("move", Access{}.read<Velocity>().write<Position>(), [](World &w) {
+    w.each<Position, const Velocity>([](Position &pos, const Velocity &vel) {
+      pos.x += vel.dx;
+      pos.y += vel.dy;
+    });
+  });
+  scheduler.add(
+    "rename", Access{}.write<Name>(), [](World &w) { w.each<Name>([](Name &name) { name.value += '!'; }); });
+  scheduler.add("count", Access{}.read<Position, Name>(), [&](World &w) {
+    total   = 0.0F;
+    renamed = 0;
+    w.each<const Position, const Name>([&](const Position &pos, const Name &name) {
+      total += pos.y;
+      if (name.value == "npc!!") { ++renamed; }
+    });
+  });
+  REQUIRE(scheduler.stageList().size() == 2);
+  REQUIRE(scheduler.stageList()[0].size() == 2);
+
+  Game::ThreadPool pool{ 2 };
+  scheduler.run(world, pool);
+  scheduler.run(world, pool);
+
+  REQUIRE(total == 4000.0F);
+  REQUIRE(renamed == 1000);
+}
+
+TEST_CASE("Game state steps keep the world index in line with the systems", "[ecs]")
+{
+  using MapObject = Game::Simulation::MapObject;
+
+  Game::GameState gs;
+  const auto      crate = gs.simulation.addMapObject(Game::AABB{ 0.0F, 0.0F, 10.0F, 10.0F });
+  gs.systems.add("push", Game::ECS::Access{}.write<MapObject>(), [](Game::ECS::World &world) {
+    world.each<MapObject>([](MapObject &object) {
+      object.bounds.minX += 100.0F;
+      object.bounds.maxX += 100.0F;
+    });
+  });
+
+  Game::ThreadPool pool{ 1 };
+  gs.step(pool);
+
+  REQUIRE_FALSE(gs.simulation.pick(5, 5));
+  REQUIRE(gs.simulation.pick(105, 5) == crate);
+}
+
+TEST_CASE("Spatial hash queries match a brute force search", "[spatial]")
+{
+  const bool withQuadtree = GENERATE(false, true);
+
+  Game::SpatialHash<int> index{ 16.0F, 64 };
+  if (withQuadtree) { index.enableLooseQuadtree(Game::AABB{ -512.0F, -512.0F, 512.0F, 512.0F }, 6, 2); }
+
+  std::mt19937                          rng{ 42 };
+  std::uniform_real_distribution<float> position{ -500.0F, 480.0F };
+  std::uniform_real_distribution<float> extent{ 0.0F, 20.0F };
+
+  std::vector<Game::AABB>                     boxes;
+  std::vector<Game::SpatialHash<int>::Handle> handles;
+  for (int object = 0; object < 400; ++object) {
+    const auto x    = position(rng);
+    const auto y    = position(rng);
+    const auto size = object % 20 == 0 ? extent(rng) * 5.0F : extent(rng);
+    boxes.push_back(Game::AABB{ x, y, x + size, y + size });
+    handles.push_back(index.insert(boxes.back(), object));
+  }
+
+  // move half of them, some only slightly and some across the world
+  for (std::size_t object = 0; object < boxes.size(); object += 2) {
+    const auto dx = object % 4 == 0 ? 1.0F : position(rng);
+    boxes[object] =
+      Game::AABB{ boxes[object].minX + dx, boxes[object].minY, boxes[object].maxX + dx, boxes[object].maxY };
+    index.move(handles[object], boxes[object]);
+  }
+
+  for (int query = 0; query < 50; ++query) {
+    const auto       x = position(rng);
+    const auto       y = position(rng);
+    const Game::AABB box{ x, y, x + extent(rng) * 3.0F, y + extent(rng) * 3.0F };
+
+    std::vector<int> found;
+    index.queryBox(box, [&](auto, const int value, const auto &) { found.push_back(value); });
+    std::sort(found.begin(), found.end());
+
+    std::vector<int> expected;
+    for (std::size_t object = 0; object < boxes.size(); ++object) {
+      if (boxes[object].intersects(box)) { expected.push_back(static_cast<int>(object)); }
+    }
+    REQUIRE(found == expected);
+
+    found.clear();
+    index.queryRadius(x, y, 30.0F, [&](auto, const int value, const auto &) { found.push_back(value); });
+    std::sort(found.begin(), found.end());
+
+    expected.clear();
+    for (std::size_t object = 0; object < boxes.size(); ++object) {
+      if (boxes[object].intersects(x, y, 30.0F)) { expected.push_back(static_cast<int>(object)); }
+    }
+    REQUIRE(found == expected);
+
+    found.clear();
+    index.queryPoint(x, y, [&](auto, const int value, const auto &) { found.push_back(value); });
+    std::sort(found.begin(), found.end());
+
+    expected.clear();
+    for (std::size_t object = 0; object < boxes.size(); ++object) {
+      if (boxes[object].contains(x, y)) { expected.push_back(static_cast<int>(object)); }
+    }
+    REQUIRE(found == expected);
+  }
+
+  Game::ThreadPool                          pool{ 3 };
+  std::vector<Game::SpatialHash<int>::Pair> pairs;
+  index.overlappingPairs(pool, pairs);
+
+  std::vector<std::pair<int, int>> found;
+  for (const auto &pair : pairs) {
+    const auto a = index.value(pair.first);
+    const auto b = index.value(pair.second);
+    found.emplace_back(std::min(a, b), std::max(a, b));
+  }
+  std::sort(found.begin(), found.end());
+
+  std::vector<std::pair<int, int>> expected;
+  for (std::size_t a = 0; a < boxes.size(); ++a) {
+    for (auto b = a + 1; b < boxes.size(); ++b) {
+      if (boxes[a].intersects(boxes[b])) { expected.emplace_back(static_cast<int>(a), static_cast<int>(b)); }
+    }
+  }
+  REQUIRE(found == expected);
+}
+
+TEST_CASE("Mouse events hover and select the smallest map object under the cursor", "[spatial]")
+{
+  using GS = Game::GameState;
+
+  GS         gs;
+  auto &     simulation = gs.simulation;
+  const auto floor = simulation.addMapObject(Game::AABB{ 0.0F, 0.0F, 200.0F, 200.0F });
+  const auto crate = simulation.addMapObject(Game::AABB{ 50.0F, 50.0F, 70.0F, 70.0F });
+  simulation.addMapObject(Game::AABB{ 300.0F, 300.0F, 320.0F, 320.0F });
+
+  gs.update(GS::Moved<GS::Mouse>{ GS::Mouse{ 60, 60 } });
+  REQUIRE(simulation.hovered == crate);
+  REQUIRE_FALSE(simulation.selected);
+
+  gs.update(GS::Moved<GS::Mouse>{ GS::Mouse{ 10, 10 } });
+  REQUIRE(simulation.hovered == floor);
+
+  gs.update(GS::Pressed<GS::MouseButton>{ GS::MouseButton{ 0, GS::Mouse{ 55, 65 } } });
+  REQUIRE(simulation.selected == crate);
+  REQUIRE(simulation.hovered == floor);
+
+  // empty space clears both
+  gs.update(GS::Moved<GS::Mouse>{ GS::Mouse{ 250, 250 } });
+  gs.update(GS::Pressed<GS::MouseButton>{ GS::MouseButton{ 0, GS::Mouse{ 250, 250 } } });
+  REQUIRE_FALSE(simulation.hovered);
+  REQUIRE_FALSE(simulation.selected);
+
+  // a moved object is picked where it is now, a removed one not at all
+  simulation.moveMapObject(crate, Game::AABB{ 400.0F, 400.0F, 420.0F, 420.0F });
+  gs.update(GS::Pressed<GS::MouseButton>{ GS::MouseButton{ 0, GS::Mouse{ 410, 410 } } });
+  REQUIRE(simulation.selected == crate);
+
+  simulation.removeMapObject(crate);
+  gs.update(GS::Pressed<GS::MouseButton>{ GS::MouseButton{ 0, GS::Mouse{ 410, 410 } } });
+  REQUIRE_FALSE(simulation.selected);
+}
+
+TEST_CASE("Simulation snapshots restore the world and the world index", "[rollback]")
+{
+  using MapObject = Game::Simulation::MapObject;
+
+  Game::ECS::Scheduler systems;
+  systems.add("push", Game::ECS::Access{}.write<MapObject>(), [](Game::ECS::World &world) {
+    world.each<MapObject>([](MapObject &object) {
+      object.bounds.minX += 10.0F;
+      object.bounds.maxX += 10.0F;
+    });
+  });
+
+  Game::Simulation simulation;
+  const auto       crate = simulation.addMapObject(Game::AABB{ 0.0F, 0.0F, 20.0F, 20.0F });
+  simulation.addMapObject(Game::AABB{ 500.0F, 500.0F, 520.0F, 520.0F });
+  simulation.hover(5, 5);
+
+  const auto snapshot = simulation;
+
+  Game::ThreadPool pool{ 1 };
+  for (int tick = 0; tick < 10; ++tick) { simulation.step(systems, pool); }
+  simulation.removeMapObject(crate);
+  simulation.select(510, 510);
+  REQUIRE_FALSE(simulation.pick(105, 5));
+  REQUIRE(simulation.world.size() == 1);
+
+  // the snapshot kept its own copy of the index, nothing above touched it
+  REQUIRE(snapshot.pick(5, 5) == crate);
+  REQUIRE_FALSE(snapshot.pick(105, 5));
+
+  simulation = snapshot;
+  REQUIRE(simulation.world.size() == 2);
+  REQUIRE(simulation.worldIndex.size() == 2);
+  REQUIRE(simulation.hovered == crate);
+  REQUIRE_FALSE(simulation.selected);
+  REQUIRE(simulation.pick(5, 5) == crate);
+
+  // and simulates on exactly like the original did
+  for (int tick = 0; tick < 10; ++tick) { simulation.step(systems, pool); }
+  REQUIRE_FALSE(simulation.pick(5, 5));
+  REQUIRE(simulation.pick(105, 5) == crate);
+  REQUIRE(simulation.world.get<MapObject>(crate)->bounds.minX == 100.0F);
+}
+
+TEST_CASE("Rollback sessions converge over a lossy, jittery link", "[rollback]")
+{
+  using Session = Game::RollbackSession<std::int64_t, int>;
+
+  auto now = Game::SimulatedNetwork::clock::time_point{};
+  auto [hostEnd, guestEnd] = Game::MemoryTransport::makePair();
+
+  const Game::SimulatedNetwork::Conditions conditions{ std::chrono::milliseconds{ 50 },
+    std::chrono::milliseconds{ 20 },
+    0.15 };
+  Game::SimulatedNetwork hostLink{ *hostEnd, conditions, 1, [&] { return now; } };
+  Game::SimulatedNetwork guestLink{ *guestEnd, conditions, 2, [&] { return now; } };
+
+  // order dependent so a wrong prediction can not cancel out
+  const auto simulate = [](std::int64_t &state, const Session::Inputs &inputs) {
+    state = state * 31 + inputs[0] * 7 + inputs[1];
+  };
+  const auto input = [](const std::uint32_t tick, const int player) {
+    return tick % 5 == 0 ? static_cast<int>(tick) + player : 0;
+  };
+
+  Session host{ 0, 0, hostLink, simulate };
+  Session guest{ 0, 1, guestLink, simulate };
+
+  constexpr std::uint32_t Ticks = 600;
+  while (host.currentTick() < Ticks || guest.currentTick() < Ticks) {
+    now += std::chrono::milliseconds{ 16 };
+    if (host.currentTick() < Ticks) { host.advance(input(host.currentTick(), 0)); } else { host.keepAlive(); }
+    if (guest.currentTick() < Ticks) { guest.advance(input(guest.currentTick(), 1)); } else { guest.keepAlive(); }
+  }
+
+  // let retransmits confirm the last predicted ticks
+  while (host.confirmedTick() != Ticks || guest.confirmedTick() != Ticks) {
+    now += std::chrono::milliseconds{ 16 };
+    host.keepAlive();
+    guest.keepAlive();
+  }
+
+  const auto expected = [&](const std::uint32_t ticks) {
+    std::int64_t state = 0;
+    for (std::uint32_t tick = 0; tick < ticks; ++tick) {
+      simulate(state, Session::Inputs{ input(tick, 0), input(tick, 1) });
+    }
+    return state;
+  };
+
+  REQUIRE(host.state() == expected(Ticks));
+  REQUIRE(guest.state() == host.state());
+  REQUIRE(host.stats().rollbacks > 0);
+  REQUIRE(guest.stats().rollbacks > 0);
+  REQUIRE(host.stats().resimulatedTicks >= host.stats().rollbacks);
+}
+
+TEST_CASE("UDP transports exchange datagrams over loopback and ignore strangers", "[rollback]")
+{
+  // let the OS hand out the ports so parallel test runs do not collide
+  const auto freePort = [] {
+    sf::UdpSocket probe;
+    REQUIRE(probe.bind(sf::Socket::AnyPort) == sf::Socket::Done);
+    return probe.getLocalPort();
+  };
+  const auto hostPort  = freePort();
+  const auto guestPort = freePort();
+  REQUIRE(hostPort != guestPort);
+
+  Game::UdpTransport host{ hostPort, sf::IpAddress::LocalHost, guestPort };
+  Game::UdpTransport guest{ guestPort, sf::IpAddress::LocalHost, hostPort };
+
+  const auto receiveWithin = [](Game::Transport &transport) {
+    for (int attempt = 0; attempt < 200; ++attempt) {
+      if (auto datagram = transport.receive()) { return datagram; }
+      std::this_thread::sleep_for(std::chrono::milliseconds{ 5 });
+    }
+    return std::optional<std::vector<std::uint8_t>>{};
+  };
+
+  REQUIRE_FALSE(guest.receive());
+
+  sf::UdpSocket                   stranger;
+  const std::vector<std::uint8_t> noise{ 9, 9, 9 };
+  REQUIRE(stranger.bind(sf::Socket::AnyPort) == sf::Socket::Done);
+  REQUIRE(stranger.send(noise.data(), noise.size(), sf::IpAddress::LocalHost, guestPort) == sf::Socket::Done);
+
+  const std::vector<std::uint8_t> hello{ 1, 2, 3, 4 };
+  host.send(hello);
+  REQUIRE(receiveWithin(guest) == hello);
+
+  const std::vector<std::uint8_t> reply{ 5, 6 };
+  guest.send(reply);
+  REQUIRE(receiveWithin(host) == reply);
+
+  // the stranger's datagram was dropped, not queued behind the peer's
+  std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+  REQUIRE_FALSE(guest.receive());
+}
+
+namespace {
+std::uint32_t pathCost(const Game::TileGrid &grid, const Game::PathService::Path &path)
+{
+  std::uint32_t cost = 0;
+  for (std::size_t step = 1; step < path.size(); ++step) {
+    REQUIRE(Game::manhattan(path[step - 1], path[step]) == 1);
+    REQUIRE(grid.passable(path[step]));
+    cost += grid.cost(path[step]);
+  }
+  return cost;
+}
+}// namespace
+
+TEST_CASE("Hierarchical paths are valid and never beat the exact search", "[pathfinding]")
+{
+  // not a multiple of the cluster size, so the last row and column are narrower
+  Game::TileGrid grid{ 90, 70 };
+  std::mt19937   rng{ 7 };
+  for (int y = 0; y < grid.height(); ++y) {
+    for (int x = 0; x < grid.width(); ++x) {
+      const auto roll = std::uniform_int_distribution<int>{ 0, 99 }(rng);
+      if (roll < 25) {
+        grid.setCost({ x, y }, Game::TileGrid::Blocked);
+      } else if (roll < 35) {
+        grid.setCost({ x, y }, 3);
+      }
+    }
+  }
+
+  Game::PathService service{ grid, 16 };
+  Game::GridSearch  exact;
+
+  std::vector<Game::PathService::Request>    requests;
+  std::vector<Game::PathService::PathHandle> serial;
+  std::uniform_int_distribution<int>         column{ 0, grid.width() - 1 };
+  std::uniform_int_distribution<int>         row{ 0, grid.height() - 1 };
+  std::size_t                                reachable = 0;
+
+  for (int query = 0; query < 300; ++query) {
+    const Game::GridPoint start{ column(rng), row(rng) };
+    const Game::GridPoint goal{ column(rng), row(rng) };
+
+    Game::PathService::Path shortest;
+    const bool              found = exact.findPath(grid, start, goal, grid.bounds(), shortest);
+    const auto              path  = service.find(start, goal);
+
+    REQUIRE(found == (path != nullptr));
+    if (found) {
+      ++reachable;
+      REQUIRE(path->front() == start);
+      REQUIRE(path->back() == goal);
+      REQUIRE(pathCost(grid, *path) >= pathCost(grid, shortest));
+    }
+
+    requests.push_back({ start, goal });
+    serial.push_back(path);
+  }
+  CHECK(reachable > 50);
+
+  SECTION("batched queries match the serial ones")
+  {
+    service.clearCache();
+    Game::ThreadPool                           pool{ 3 };
+    std::vector<Game::PathService::PathHandle> batched(requests.size());
+    service.findBatch(requests, batched, pool);
+
+    for (std::size_t index = 0; index < requests.size(); ++index) {
+      REQUIRE((batched[index] == nullptr) == (serial[index] == nullptr));
+      if (batched[index]) { REQUIRE(*batched[index] == *serial[index]); }
+    }
+  }
+}
+
+TEST_CASE("More expensive tiles only invalidate the cached paths through them", "[pathfinding]")
+{
+  Game::PathService service{ Game::TileGrid{ 64, 64 }, 16 };
+
+  const Game::GridPoint start{ 2, 30 };
+  const Game::GridPoint goal{ 61, 33 };
+  const auto            path = service.find(start, goal);
+  REQUIRE(path);
+  REQUIRE(service.find(start, goal) == path);
+  REQUIRE(service.stats().hits == 1);
+
+  // more expensive, but not on the path
+  const Game::GridPoint aside{ 20, 5 };
+  REQUIRE(std::find(path->begin(), path->end(), aside) == path->end());
+  service.setCost(aside, 9);
+  REQUIRE(service.find(start, goal) == path);
+  REQUIRE(service.stats().invalidated == 0);
+
+  // blocking a tile of the path forces a detour
+  const auto blocked = (*path)[path->size() / 2];
+  service.setCost(blocked, Game::TileGrid::Blocked);
+  REQUIRE(service.stats().invalidated == 1);
+
+  const auto detour = service.find(start, goal);
+  REQUIRE(detour);
+  REQUIRE(detour != path);
+  REQUIRE(std::find(detour->begin(), detour->end(), blocked) == detour->end());
+
+  // reopening it finds a path as cheap as the original again
+  service.setCost(blocked, 1);
+  REQUIRE(service.stats().invalidated == 2);
+  const auto reopened = service.find(start, goal);
+  REQUIRE(reopened);
+  REQUIRE(pathCost(service.grid(), *reopened) == pathCost(service.grid(), *path));
+  REQUIRE(pathCost(service.grid(), *reopened) <= pathCost(service.grid(), *detour));
+}
+
+TEST_CASE("Opening a wall invalidates the cached detours around it", "[pathfinding]")
+{
+  Game::TileGrid grid{ 64, 64 };
+  for (int y = 0; y < 63; ++y) { grid.setCost({ 32, y }, Game::TileGrid::Blocked); }
+
+  Game::PathService service{ grid, 16 };
+
+  // the only way across is the gap at the bottom, far from the goal's row
+  const Game::GridPoint start{ 2, 30 };
+  const Game::GridPoint goal{ 61, 30 };
+  const auto            detour = service.find(start, goal);
+  REQUIRE(detour);
+  REQUIRE(detour->size() == 126);
+
+  // the new gap is in clusters the cached detour never crosses
+  service.setCost({ 32, 5 }, 1);
+  const auto shortcut = service.find(start, goal);
+  REQUIRE(shortcut);
+  REQUIRE(shortcut != detour);
+  REQUIRE(pathCost(service.grid(), *shortcut) < pathCost(service.grid(), *detour));
+
+  Game::PathService fresh{ service.grid(), 16 };
+  const auto        expected = fresh.find(start, goal);
+  REQUIRE(expected);
+  REQUIRE(*shortcut == *expected);
+}
+
+TEST_CASE("Queries without a path are cached until a tile gets cheaper", "[pathfinding]")
+{
+  Game::PathService service{ Game::TileGrid{ 64, 64 }, 16 };
+
+  // walls the goal in
+  const Game::GridPoint goal{ 40, 40 };
+  for (int y = 38; y <= 42; ++y) {
+    for (int x = 38; x <= 42; ++x) {
+      if (std::abs(x - goal.x) == 2 || std::abs(y - goal.y) == 2) {
+        service.setCost(Game::GridPoint{ x, y }, Game::TileGrid::Blocked);
+      }
+    }
+  }
+
+  const Game::GridPoint start{ 3, 5 };
+  REQUIRE_FALSE(service.find(start, goal));
+  REQUIRE(service.stats().misses == 1);
+  REQUIRE_FALSE(service.find(start, goal));
+  REQUIRE(service.stats().hits == 1);
+
+  const std::array requests{ Game::PathService::Request{ start, goal },
+    Game::PathService::Request{ Game::GridPoint{ 60, 2 }, goal } };
+
+  std::array<Game::PathService::PathHandle, 2> results;
+  Game::ThreadPool                             pool{ 2 };
+  service.findBatch(requests, results, pool);
+  REQUIRE_FALSE(results[0]);
+  REQUIRE_FALSE(results[1]);
+  REQUIRE(service.stats().hits == 2);
+  REQUIRE(service.stats().misses == 2);
+
+  // a more expensive tile can not open a path
+  service.setCost(Game::GridPoint{ 10, 10 }, 5);
+  REQUIRE_FALSE(service.find(start, goal));
+  REQUIRE(service.stats().hits == 3);
+  REQUIRE(service.stats().invalidated == 0);
+
+  service.setCost(Game::GridPoint{ 40, 38 }, 1);
+  REQUIRE(service.stats().invalidated == 2);
+  const auto opened = service.find(start, goal);
+  REQUIRE(opened);
+  REQUIRE(opened->back() == goal);
+}
+
+TEST_CASE("Shelf packed rectangles stay on the page and never overlap", "[atlas]")
+{
+  Game::ShelfPacker packer{ 256, 256 };
+
+  std::mt19937                                 rng{ 42 };
+  std::uniform_int_distribution<std::uint32_t> sizes{ 4, 40 };
+
+  std::vector<Game::PackedRect> packed;
+  while (const auto rect = packer.insert(sizes(rng), sizes(rng))) { packed.push_back(*rect); }
+  REQUIRE(packed.size() > 20);
+
+  std::uint64_t area = 0;
+  for (std::size_t index = 0; index < packed.size(); ++index) {
+    const auto &rect = packed[index];
+    REQUIRE(rect.x + rect.width <= packer.pageWidth());
+    REQUIRE(rect.y + rect.height <= packer.pageHeight());
+    area += std::uint64_t{ rect.width } * rect.height;
+
+    for (std::size_t other = 0; other < index; ++other) {
+      const auto &prior    = packed[other];
+      const bool  disjoint = rect.x + rect.width <= prior.x || prior.x + prior.width <= rect.x
+                            || rect.y + rect.height <= prior.y || prior.y + prior.height <= rect.y;
+      REQUIRE(disjoint);
+    }
+  }
+  REQUIRE(packer.occupancy() == Approx(static_cast<double>(area) / (256.0 * 256.0)));
+}
+
+TEST_CASE("Shelf packing prefers the shelf that wastes the least height", "[atlas]")
+{
+  Game::ShelfPacker packer{ 64, 64 };
+
+  REQUIRE(packer.insert(10, 32) == Game::PackedRect{ 0, 0, 10, 32 });
+  REQUIRE(packer.insert(10, 16) == Game::PackedRect{ 10, 0, 10, 16 });
+  // too wide for the first shelf's remaining space, opens a 16 high shelf
+  REQUIRE(packer.insert(50, 16) == Game::PackedRect{ 0, 32, 50, 16 });
+  // fits both shelves, the lower one is a tighter fit
+  REQUIRE(packer.insert(8, 12) == Game::PackedRect{ 50, 32, 8, 12 });
+  REQUIRE(packer.insert(8, 20) == Game::PackedRect{ 20, 0, 8, 20 });
+
+  REQUIRE_FALSE(packer.insert(65, 1));
+  REQUIRE_FALSE(packer.insert(0, 4));
+  REQUIRE(packer.insert(64, 16) == Game::PackedRect{ 0, 48, 64, 16 });
+  REQUIRE(packer.insert(36, 17) == Game::PackedRect{ 28, 0, 36, 17 });
+  REQUIRE_FALSE(packer.insert(1, 17));
+}
+
+namespace {
+// a scratch directory of small JSON files, removed again by the destructor
+struct AssetDirectory
+{
+  std::filesystem::path root = std::filesystem::temp_directory_path() / "game_asset_tests";
+
+  AssetDirectory() { std::filesystem::create_directories(root); }
+  AssetDirectory(const AssetDirectory &) = delete;
+  AssetDirectory(AssetDirectory &&)      = delete;
+  AssetDirectory &operator=(const AssetDirectory &) = delete;
+  AssetDirectory &operator=(AssetDirectory &&) = delete;
+  ~AssetDirectory() { std::filesystem::remove_all(root); }
+
+  std::filesystem::path write(const std::string &name, const nlohmann::json &value) const
+  {
+    const auto path = root / name;
+    std::ofstream{ path } << value;
+    return path;
+  }
+};
+
+// lets the workers finish decoding without running any upload
+void waitForUploads(const Game::AssetManager &assets, const std::size_t count)
+{
+  while (assets.pendingUploads() < count) { std::this_thread::yield(); }
+}
+}// namespace
+
+TEST_CASE("Assets loaded through the same path share one slot", "[assets]")
+{
+  const AssetDirectory directory;
+  const auto           path = directory.write("map.json", nlohmann::json{ { "width", 10 } });
+
+  Game::ThreadPool   pool{ 2 };
+  Game::AssetManager assets{ pool };
+
+  const auto first  = assets.load<nlohmann::json>(path);
+  const auto second = assets.load<nlohmann::json>(directory.root / "." / "map.json");
+  REQUIRE(assets.cached() == 1);
+
+  REQUIRE(assets.wait(first).at("width") == 10);
+  REQUIRE(second.ready());
+  REQUIRE(&first.get() == &second.get());
+
+  // the same file as another type is a separate asset
+  const auto events = assets.load<std::vector<Game::GameState::Event>>(path);
+  REQUIRE(assets.cached() == 2);
+  REQUIRE_THROWS(assets.wait(events));
+}
+
+TEST_CASE("Assets that fail to load report the error", "[assets]")
+{
+  Game::ThreadPool   pool{ 2 };
+  Game::AssetManager assets{ pool };
+
+  const auto missing = assets.load<nlohmann::json>(std::filesystem::temp_directory_path() / "no_such_asset.json");
+  REQUIRE_THROWS_AS(assets.wait(missing), std::runtime_error);
+  REQUIRE(missing.state() == Game::AssetState::Failed);
+  REQUIRE(missing.error().find("unable to open") != std::string::npos);
+  REQUIRE_THROWS_AS(missing.get(), std::logic_error);
+}
+
+TEST_CASE("Empty asset handles throw instead of loading", "[assets]")
+{
+  Game::ThreadPool   pool{ 1 };
+  Game::AssetManager assets{ pool };
+
+  const Game::Asset<nlohmann::json> empty;
+  REQUIRE(empty.empty());
+  REQUIRE(empty.state() == Game::AssetState::Failed);
+  REQUIRE_THROWS_AS(assets.wait(empty), std::logic_error);
+  REQUIRE_THROWS_AS(empty.get(), std::logic_error);
+  REQUIRE_THROWS_AS(empty.path(), std::logic_error);
+}
+
+TEST_CASE("Disk cached images are only used for the source they came from", "[assets]")
+{
+  const AssetDirectory       directory;
+  const Game::AssetDiskCache cache{ directory.root / "cache" };
+  const auto                 first  = directory.write("first.json", nlohmann::json{ 1 });
+  const auto                 second = directory.write("second.json", nlohmann::json{ 2 });
+
+  sf::Image image;
+  image.create(2, 3, sf::Color::Red);
+  cache.storeImage(first, image);
+
+  const auto loaded = cache.loadImage(first);
+  REQUIRE(loaded);
+  REQUIRE(loaded->getSize() == sf::Vector2u(2, 3));
+  REQUIRE(loaded->getPixel(1, 2) == sf::Color::Red);
+  REQUIRE_FALSE(cache.loadImage(second));
+
+  // entries are named after a hash of the source path: fake a collision
+  const auto entryFor = [&](const std::filesystem::path &source) {
+    return directory.root / "cache"
+           / (std::to_string(std::hash<std::string>{}(std::filesystem::absolute(source).string())) + ".rgba");
+  };
+  std::filesystem::copy_file(entryFor(first), entryFor(second));
+  REQUIRE_FALSE(cache.loadImage(second));
+
+  // a changed source does not match its old entry
+  std::ofstream{ first, std::ios::app } << ' ';
+  REQUIRE_FALSE(cache.loadImage(first));
+}
+
+TEST_CASE("Event streams round trip through the asset loader", "[assets]")
+{
+  using Game::GameState;
+
+  const std::vector<GameState::Event> recorded{ GameState::TimeElapsed{ std::chrono::milliseconds{ 16 } },
+    GameState::CloseWindow{} };
+
+  const AssetDirectory directory;
+  const auto           path = directory.write("events.json", nlohmann::json(recorded));
+
+  Game::ThreadPool   pool{ 2 };
+  Game::AssetManager assets{ pool };
+  REQUIRE(assets.wait(assets.load<std::vector<GameState::Event>>(path)) == recorded);
+}
+
+TEST_CASE("Uploads stop at their time budget", "[assets]")
+{
+  constexpr std::size_t count = 8;
+
+  const AssetDirectory directory;
+  Game::ThreadPool     pool{ 2 };
+  Game::AssetManager   assets{ pool };
+
+  std::vector<Game::Asset<nlohmann::json>> loaded;
+  for (std::size_t index = 0; index < count; ++index) {
+    loaded.push_back(assets.load<nlohmann::json>(directory.write(std::to_string(index) + ".json", index)));
+  }
+  waitForUploads(assets, count);
+
+  // a spent budget still makes progress, one upload per call
+  REQUIRE(assets.uploadPending(std::chrono::microseconds{ 0 }) == 1);
+  REQUIRE(assets.uploadPending(std::chrono::microseconds{ 0 }) == 1);
+  REQUIRE(assets.pendingUploads() == count - 2);
+
+  REQUIRE(assets.uploadPending(std::chrono::seconds{ 10 }) == count - 2);
+  REQUIRE(assets.pendingUploads() == 0);
+  for (std::size_t index = 0; index < count; ++index) { REQUIRE(loaded[index].get() == index); }
+}
+
+TEST_CASE("Collecting drops only assets nobody refers to", "[assets]")
+{
+  const AssetDirectory directory;
+  Game::ThreadPool     pool{ 2 };
+  Game::AssetManager   assets{ pool };
+
+  const auto kept = assets.load<nlohmann::json>(directory.write("kept.json", 1));
+  {
+    const auto dropped = assets.load<nlohmann::json>(directory.write("dropped.json", 2));
+    assets.wait(dropped);
+  }
+  assets.wait(kept);
+  REQUIRE(assets.cached() == 2);
+
+  REQUIRE(assets.collect() == 1);
+  REQUIRE(assets.cached() == 1);
+  REQUIRE(kept.get() == 1);
+
+  // loading it again starts over with a new slot
+  const auto reloaded = assets.load<nlohmann::json>(directory.root / "dropped.json");
+  REQUIRE(assets.cached() == 2);
+  REQUIRE(assets.wait(reloaded) == 2);
+}